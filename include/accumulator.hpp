@@ -0,0 +1,119 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#ifndef __wasm__
+#include <algorithm>
+#endif
+
+#include <proofcheck.hpp>
+
+// Append-only merkle mountain range over the sorted receipt digests of an archived epoch.
+//
+// Digests are appended in ascending order, so a digest absent from the archive sits between two adjacent leaves (or
+// before the first one). A non-membership witness is the membership proof of those neighbours.
+//
+// The contract keeps every peak, so a membership proof only needs to reach the peak holding the leaf.
+
+namespace accumulator {
+
+   using namespace eosio;
+
+   struct leaf_proof {
+      checksum256                   leaf;
+      std::vector<checksum256>      path;    // siblings from the leaf up to its peak
+   };
+
+   struct nonmembership_witness {
+      uint64_t                      hi_index;   // index of the smallest archived digest above the proven one
+      leaf_proof                    hi;
+      std::optional<leaf_proof>     lo;         // the leaf at hi_index - 1, absent when hi_index is 0
+   };
+
+   struct mmr {
+      std::vector<checksum256>      peaks;        // largest subtree first
+      uint64_t                      leaf_count = 0;
+
+      void append(const checksum256& leaf) {
+         checksum256 node = leaf;
+         for (uint64_t height = 0; (leaf_count >> height) & 1; height++) {
+            node = proofcheck::hash_concat(peaks.back(), node);
+            peaks.pop_back();
+         }
+         peaks.push_back(node);
+         leaf_count++;
+      }
+
+      bool contains(const uint64_t index, const leaf_proof& proof) const {
+         if (index >= leaf_count) return false;
+
+         //find the peak covering `index`, one per set bit of leaf_count from the highest
+         uint64_t start = 0;
+         size_t peak = 0;
+         for (int height = 63; height >= 0; height--) {
+            uint64_t size = uint64_t(1) << height;
+            if ((leaf_count & size) == 0) continue;
+            if (index < start + size) {
+               if (proof.path.size() != size_t(height)) return false;
+
+               checksum256 node = proof.leaf;
+               uint64_t position = index - start;
+               for (int i = 0; i < height; i++) {
+                  node = ((position >> i) & 1) ? proofcheck::hash_concat(proof.path[i], node) : proofcheck::hash_concat(node, proof.path[i]);
+               }
+               return node == peaks[peak];
+            }
+            start += size;
+            peak++;
+         }
+         return false;
+      }
+
+      bool excludes(const checksum256& digest, const nonmembership_witness& witness) const {
+         if (!(digest < witness.hi.leaf) || !contains(witness.hi_index, witness.hi)) return false;
+         if (witness.hi_index == 0) return true;
+         return witness.lo.has_value() && witness.lo->leaf < digest && contains(witness.hi_index - 1, *witness.lo);
+      }
+   };
+
+#ifndef __wasm__
+   //membership proof of leaf `index`, from all the leaves appended so far (host side)
+   inline leaf_proof prove(const std::vector<checksum256>& leaves, const uint64_t index) {
+      leaf_proof proof{ leaves[index], {} };
+
+      uint64_t start = 0;
+      for (int height = 63; height >= 0; height--) {
+         uint64_t size = uint64_t(1) << height;
+         if ((leaves.size() & size) == 0) continue;
+         if (index < start + size) {
+            std::vector<checksum256> level(leaves.begin() + start, leaves.begin() + start + size);
+            uint64_t position = index - start;
+            while (level.size() > 1) {
+               proof.path.push_back(level[position ^ 1]);
+               std::vector<checksum256> next;
+               for (size_t i = 0; i < level.size(); i += 2) next.push_back(proofcheck::hash_concat(level[i], level[i + 1]));
+               level = std::move(next);
+               position >>= 1;
+            }
+            break;
+         }
+         start += size;
+      }
+      return proof;
+   }
+
+   //non-membership witness for `digest` against the sorted leaves of an archive, empty if the digest is archived (host side)
+   inline std::optional<nonmembership_witness> witness(const std::vector<checksum256>& leaves, const checksum256& digest) {
+      auto hi = std::upper_bound(leaves.begin(), leaves.end(), digest);
+      if (hi == leaves.end()) return std::nullopt;   // above every archived digest, no witness needed
+      if (hi != leaves.begin() && *(hi - 1) == digest) return std::nullopt;
+
+      uint64_t hi_index = hi - leaves.begin();
+      nonmembership_witness w{ hi_index, prove(leaves, hi_index), std::nullopt };
+      if (hi_index > 0) w.lo = prove(leaves, hi_index - 1);
+      return w;
+   }
+#endif
+
+}
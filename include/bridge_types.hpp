@@ -0,0 +1,180 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/crypto.hpp>
+#include <eosio/multi_index.hpp>
+#include <eosio/producer_schedule.hpp>
+
+// Types exchanged with the bridge contract and the bridge tables read by its clients, without the contract class.
+// Contracts talking to the bridge include this header only, so they carry none of the bridge's code.
+// bridge.hpp aliases these types as members of the `bridge` contract class.
+
+namespace bridgetypes {
+
+   using namespace eosio;
+
+   inline uint32_t reverse_bytes(uint32_t input) {
+      return (input >> 24 & 0xff) | (input >> 8 & 0xff00) | (input << 8 & 0xff0000) | (input << 24 & 0xff000000);
+   }
+
+   //block id: block number (big endian) followed by the last 28 bytes of the header digest
+   inline checksum256 compute_block_id(checksum256 hash, uint32_t block_num) {
+      std::array<uint8_t, 32> ab = hash.extract_as_byte_array();
+      uint32_t r_block_num = reverse_bytes(block_num);
+      memcpy(ab.data(), (uint8_t *)&r_block_num, 4);
+      return checksum256(ab);
+   }
+
+   inline uint32_t get_block_num_from_id(checksum256 id) {
+      std::array<uint8_t, 32> ab = id.extract_as_byte_array();
+      return ab[3] | (ab[2] << 8) | (ab[1] << 16) | (ab[0] << 24);
+   }
+
+   struct r_action_base {
+      eosio::name                      account;
+      eosio::name                      name;
+      std::vector<permission_level>    authorization;
+   };
+
+   struct r_action : r_action_base {
+      std::vector<char>    data;
+
+      EOSLIB_SERIALIZE( r_action, (account)(name)(authorization)(data))
+   };
+
+   struct schedulev2 {
+      uint32_t                            version;
+      std::vector<producer_authority>     producers;
+
+      EOSLIB_SERIALIZE( schedulev2, (version)(producers))
+   };
+
+   struct blockheader {
+      block_timestamp      timestamp;
+      name                 producer;
+      uint16_t             confirmed;
+      checksum256          previous;
+      checksum256          transaction_mroot;
+      checksum256          action_mroot;
+      uint32_t             schedule_version;
+
+      std::optional<producer_schedule>                         new_producers;
+      std::vector<std::pair<uint16_t,std::vector<char>>>       header_extensions;
+
+      checksum256 digest() const {
+         std::vector<char> serialized = pack(*this);
+         return sha256(serialized.data(), serialized.size());
+      }
+
+      uint32_t block_num() const { return get_block_num_from_id(previous) + 1; }
+      checksum256 block_id() const { return compute_block_id(digest(), block_num()); }
+
+      EOSLIB_SERIALIZE( blockheader, (timestamp)(producer)(confirmed)(previous)(transaction_mroot)(action_mroot)(schedule_version)(new_producers)(header_extensions))
+   };
+
+   //signed block header
+   struct sblockheader {
+      blockheader                header;
+      std::vector<signature>     producer_signatures;
+      checksum256                previous_bmroot;
+      std::vector<uint16_t>      bmproofpath;
+
+      EOSLIB_SERIALIZE( sblockheader, (header)(producer_signatures)(previous_bmroot)(bmproofpath))
+   };
+
+   //full block header with its incremental merkle tree data (active_nodes and node_count)
+   struct anchorblock {
+      sblockheader               block;
+      std::vector<uint16_t>      active_nodes;
+      uint64_t                   node_count;
+
+      EOSLIB_SERIALIZE( anchorblock, (block)(active_nodes)(node_count))
+   };
+
+   struct authseq {
+      name        account;
+      uint64_t    sequence;
+
+      EOSLIB_SERIALIZE( authseq, (account)(sequence) )
+   };
+
+   struct actreceipt {
+      name                    receiver;
+      checksum256             act_digest;
+      uint64_t                global_sequence = 0;
+      uint64_t                recv_sequence   = 0;
+      std::vector<authseq>    auth_sequence;
+      unsigned_int            code_sequence = 0;
+      unsigned_int            abi_sequence  = 0;
+
+      EOSLIB_SERIALIZE( actreceipt, (receiver)(act_digest)(global_sequence)(recv_sequence)(auth_sequence)(code_sequence)(abi_sequence) )
+   };
+
+   typedef std::vector<checksum256> checksum256_list; // required because nested vectors not support in legacy CDTs
+
+   //heavy block proof
+   struct heavyproof {
+      checksum256                   chain_id;
+      std::vector<checksum256>      hashes;
+      anchorblock                   blocktoprove;
+      std::vector<sblockheader>     bftproof;
+
+      EOSLIB_SERIALIZE( heavyproof, (chain_id)(hashes)(blocktoprove)(bftproof))
+   };
+
+   //light block proof
+   struct lightproof {
+      checksum256                   chain_id;
+      blockheader                   header;
+      checksum256                   root;
+      std::vector<checksum256>      bmproofpath;
+
+      EOSLIB_SERIALIZE( lightproof, (chain_id)(header)(root)(bmproofpath))
+   };
+
+   //action proof
+   struct actionproof {
+      eosio::action                 action;
+      actreceipt                    receipt;
+      std::vector<char>             returnvalue;
+      std::vector<checksum256>      amproofpath;
+
+      EOSLIB_SERIALIZE( actionproof, (action)(receipt)(returnvalue)(amproofpath))
+   };
+
+   //basic chain meta data, global scope
+   struct chain {
+      eosio::name    name;
+      checksum256    chain_id;
+      uint32_t       return_value_activated;
+
+      uint64_t primary_key()const { return name.value; }
+      checksum256 by_chain_id()const { return chain_id; }
+
+      EOSLIB_SERIALIZE( chain, (name)(chain_id)(return_value_activated) )
+   };
+
+   //heavy proven block root, usable by light proofs, scoped by readable chain name
+   struct lastproof {
+      uint64_t       id;
+      uint32_t       block_height;
+      checksum256    block_merkle_root;
+      time_point     expiry;
+
+      uint64_t primary_key()const { return id; }
+      uint64_t by_block_height()const { return block_height; }
+      checksum256 by_merkle_root()const { return block_merkle_root; }
+      uint64_t by_expiry()const { return expiry.sec_since_epoch(); }
+
+      EOSLIB_SERIALIZE( lastproof, (id)(block_height)(block_merkle_root)(expiry) )
+   };
+
+   typedef eosio::multi_index< "chains"_n, chain,
+      indexed_by<"chainid"_n, const_mem_fun<chain, checksum256, &chain::by_chain_id>>> chainstable;
+
+   typedef eosio::multi_index< "lastproofs"_n, lastproof,
+      indexed_by<"height"_n, const_mem_fun<lastproof, uint64_t, &lastproof::by_block_height>>,
+      indexed_by<"merkleroot"_n, const_mem_fun<lastproof, checksum256, &lastproof::by_merkle_root>>,
+      indexed_by<"expiry"_n, const_mem_fun<lastproof, uint64_t, &lastproof::by_expiry>>> proofstable;
+
+}
@@ -0,0 +1,387 @@
+#pragma once
+
+#ifdef __wasm__
+#error "chainfixture.hpp is host side tooling and cannot be built into the contract"
+#endif
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <optional>
+#include <set>
+#include <vector>
+
+#include <proofcheck.hpp>
+
+// Synthetic signed chains for offline end to end runs.
+//
+// `chainfixture::chain` produces blocks signed by a producer schedule, with real action_mroot values over the action
+// receipts, a block merkle tree over the block ids, and schedule changes announced through the producer schedule
+// change header extension. It hands out heavy, light and action proofs for any of its blocks.
+//
+// `chainfixture::mock_bridge` stands in for the bridge contract: it verifies those proofs with the proofcheck checks
+// behind the bridge's entry points (`checkproofa` to `checkprooff`), records the block roots of heavy proven blocks
+// for light proofs, and follows the schedule changes it proves.
+//
+// The fixture derives every digest it produces from the byte layouts the chain hashes (`chainfixture::digests`),
+// not through the proofcheck helpers it is used to test; only sha256 itself is shared, checked against published
+// vectors in tests/proofcheck_tests.cpp.
+//
+// Signatures use a test scheme by default (the signature carries the key and the signed digest), a real signer and
+// key recovery can be supplied instead. A new schedule takes effect one round of the current schedule after the block
+// announcing it, so that block can be confirmed by the current producers; blocks in between sign over the new one.
+
+namespace chainfixture {
+
+   using namespace eosio;
+
+   //test signature scheme: keys derive from the producer name, a signature is the key followed by the signed digest
+   inline public_key test_key(const name& producer) {
+      auto h = proofcheck::hash_of(producer).extract_as_byte_array();
+      std::array<char, 33> k{};
+      k[0] = 0x02;
+      memcpy(k.data() + 1, h.data(), 32);
+      return public_key(std::in_place_index<0>, k);
+   }
+
+   inline signature test_sign(const name& producer, const checksum256& digest) {
+      auto k = std::get<0>(test_key(producer));
+      auto d = digest.extract_as_byte_array();
+      std::array<char, 65> s{};
+      memcpy(s.data(), k.data(), 33);
+      memcpy(s.data() + 33, d.data(), 32);
+      return signature(std::in_place_index<0>, s);
+   }
+
+   inline public_key test_recover(const checksum256& digest, const signature& sig) {
+      const auto& s = std::get<0>(sig);
+      auto d = digest.extract_as_byte_array();
+      std::array<char, 33> k{};
+      if (memcmp(s.data() + 33, d.data(), 32) == 0) memcpy(k.data(), s.data(), 33);
+      return public_key(std::in_place_index<0>, k);
+   }
+
+   inline bridgetypes::schedulev2 make_schedule(const uint32_t version, const std::vector<name>& producers, const std::function<public_key(const name&)>& key = test_key) {
+      bridgetypes::schedulev2 schedule{ version, {} };
+      for (const auto& p : producers) {
+         schedule.producers.push_back(producer_authority{ p, block_signing_authority_v0{ 1, { key_weight{ key(p), 1 } } } });
+      }
+      return schedule;
+   }
+
+   namespace digests {
+
+      inline checksum256 sha256(const std::vector<char>& bytes) { return proofcheck::hash(bytes.data(), bytes.size()); }
+
+      template<typename T>
+      checksum256 of(const T& value) { return sha256(pack(value)); }
+
+      //nodes of the block and action merkle trees: the left node has its top bit cleared, the right one set
+      inline checksum256 pair(const checksum256& left, const checksum256& right) {
+         auto l = left.extract_as_byte_array();
+         auto r = right.extract_as_byte_array();
+         l[0] &= 0x7f;
+         r[0] |= 0x80;
+         return of(std::make_pair(checksum256(l), checksum256(r)));
+      }
+
+      inline checksum256 merkle(std::vector<checksum256> nodes) {
+         if (nodes.empty()) return checksum256();
+         while (nodes.size() > 1) {
+            std::vector<checksum256> parents;
+            for (size_t i = 0; i < nodes.size(); i += 2) parents.push_back(pair(nodes[i], i + 1 < nodes.size() ? nodes[i + 1] : nodes[i]));
+            nodes = std::move(parents);
+         }
+         return nodes[0];
+      }
+
+      //header digest with the block number, big endian, over its first 4 bytes
+      inline checksum256 block_id(const checksum256& header_digest, const uint32_t block_num) {
+         auto id = header_digest.extract_as_byte_array();
+         for (int i = 0; i < 4; i++) id[i] = uint8_t(block_num >> (24 - 8 * i));
+         return checksum256(id);
+      }
+
+      inline checksum256 action(const eosio::action& act, const std::vector<char>& returnvalue, const bool return_value_activated) {
+         if (!return_value_activated) return of(act);
+         return of(std::make_pair(of(std::make_tuple(act.account, act.name, act.authorization)), of(std::make_pair(act.data, returnvalue))));
+      }
+
+      inline checksum256 signed_digest(const checksum256& header_digest, const checksum256& bmroot, const checksum256& schedule_hash) {
+         return of(std::make_pair(of(std::make_pair(header_digest, bmroot)), schedule_hash));
+      }
+
+   }
+
+   inline proofcheck::schedule to_schedule(const bridgetypes::schedulev2& s) { return { s.version, s.producers, digests::of(s) }; }
+
+   // an `emitxfer` action as sent by wraplock or the wrapped token contract
+   inline action emitxfer(const name& contract, const name& owner, const extended_asset& quantity, const name& beneficiary) {
+      action act;
+      act.account = contract;
+      act.name = "emitxfer"_n;
+      act.authorization = { permission_level{ contract, "active"_n } };
+      act.data = pack(std::make_tuple(owner, quantity, beneficiary));
+      return act;
+   }
+
+   class chain {
+      public:
+         using signer = std::function<signature(const name& producer, const checksum256& digest)>;
+
+         chain(const checksum256& chain_id, const std::vector<name>& producers, const uint32_t return_value_activated = 1,
+               const uint32_t blocks_per_producer = 1, signer sign = test_sign, const time_point_sec genesis = time_point_sec(1600000000))
+         : _chain_id(chain_id), _return_value_activated(return_value_activated), _blocks_per_producer(std::max<uint32_t>(blocks_per_producer, 1)),
+           _sign(std::move(sign)), _genesis(genesis), _schedule(make_schedule(0, producers)) {
+            _schedules[0] = _schedule;
+         }
+
+         const checksum256& chain_id() const { return _chain_id; }
+         uint32_t head_block_num() const { return _blocks.size(); }
+         uint32_t return_value_activated() const { return _return_value_activated; }
+         const bridgetypes::schedulev2& active_schedule() const { return _schedule; }
+         const bridgetypes::schedulev2& schedule(const uint32_t version) const { return _schedules.at(version); }
+
+         // queues an action for the next block
+         void push_action(const action& act, const std::vector<char>& returnvalue = {}) { _pending.push_back({ act, returnvalue }); }
+
+         // announces a new schedule in the next block
+         void set_producers(const std::vector<name>& producers) { _proposed = make_schedule((_pending_schedule ? _pending_schedule->second.version : _schedule.version) + 1, producers); }
+
+         // produces a block with the queued actions, returns its number
+         uint32_t produce_block() {
+            uint32_t num = _blocks.size() + 1;
+            if (_pending_schedule && num >= _pending_schedule->first) {
+               _schedule = _pending_schedule->second;
+               _pending_schedule.reset();
+            }
+            bool rv_active = _return_value_activated != 0 && num >= _return_value_activated;
+
+            block b;
+            b.block_merkle = _block_merkle;
+
+            std::vector<checksum256> receipt_digests;
+            for (auto& [act, rv] : _pending) {
+               bridgetypes::actreceipt receipt;
+               receipt.receiver = act.account;
+               receipt.act_digest = digests::action(act, rv, rv_active);
+               receipt.global_sequence = ++_global_sequence;
+               receipt.recv_sequence = ++_recv_sequence[act.account];
+               for (const auto& auth : act.authorization) receipt.auth_sequence.push_back({ auth.actor, ++_auth_sequence[auth.actor] });
+               receipt.code_sequence = 1;
+               receipt.abi_sequence = 1;
+
+               receipt_digests.push_back(digests::of(receipt));
+               b.actions.push_back(bridgetypes::actionproof{ act, receipt, rv, {} });
+            }
+            _pending.clear();
+
+            auto& header = b.signed_header.header;
+            header.timestamp = block_timestamp(time_point(_genesis) + microseconds(int64_t(num) * 500000));
+            header.producer = _schedule.producers[((num - 1) / _blocks_per_producer) % _schedule.producers.size()].producer_name;
+            header.confirmed = 0;
+            header.previous = _blocks.empty() ? digests::block_id(digests::of(_chain_id), 0) : _blocks.back().id;
+            header.transaction_mroot = checksum256();
+            header.action_mroot = digests::merkle(receipt_digests);
+            header.schedule_version = _schedule.version;
+            if (_proposed) header.header_extensions.push_back({ proofcheck::SCHEDULE_CHANGE_EXTENSION, pack(*_proposed) });
+
+            b.signed_header.previous_bmroot = digests::merkle(block_ids(num - 1));
+            b.schedule_version = _schedule.version;
+
+            checksum256 digest = digests::of(header);
+            checksum256 schedule_hash = digests::of(_proposed ? *_proposed : _pending_schedule ? _pending_schedule->second : _schedule);   // latest proposed schedule
+            checksum256 signed_digest = digests::signed_digest(digest, b.signed_header.previous_bmroot, schedule_hash);
+            b.signed_header.producer_signatures.push_back(_sign(header.producer, signed_digest));
+
+            b.id = digests::block_id(digest, num);
+            _block_merkle.append(b.id);
+            _blocks.push_back(std::move(b));
+
+            if (_proposed) {
+               _schedules[_proposed->version] = *_proposed;
+               _pending_schedule = { num + 1 + uint32_t(_schedule.producers.size()) * _blocks_per_producer, *_proposed };
+               _proposed.reset();
+            }
+            return num;
+         }
+
+         // proof of `block_num` with the blocks confirming it, until 2/3+1 of the producers of one schedule have signed
+         bridgetypes::heavyproof heavy_proof(const uint32_t block_num) const {
+            const block& b = at(block_num);
+
+            bridgetypes::heavyproof proof;
+            proof.chain_id = _chain_id;
+            proof.blocktoprove.block = b.signed_header;
+            proof.blocktoprove.node_count = b.block_merkle.node_count;
+
+            // `hashes` is shared by the active nodes and the bft merkle paths, each distinct node stored once
+            auto hash_index = [&](const checksum256& node) {
+               auto i = std::find(proof.hashes.begin(), proof.hashes.end(), node);
+               if (i == proof.hashes.end()) i = proof.hashes.insert(i, node);
+               return uint16_t(i - proof.hashes.begin());
+            };
+            for (const auto& node : b.block_merkle.active_nodes) proof.blocktoprove.active_nodes.push_back(hash_index(node));
+
+            std::vector<checksum256> ids = block_ids(block_num);
+
+            std::map<uint32_t, std::set<name>> confirming;
+            confirming[b.schedule_version].insert(b.signed_header.header.producer);
+            auto confirmed = [&]() {
+               return std::any_of(confirming.begin(), confirming.end(), [&](const auto& c) { return c.second.size() >= schedule(c.first).producers.size() * 2 / 3 + 1; });
+            };
+            for (uint32_t n = block_num + 1; !confirmed() && n <= _blocks.size(); n++) {
+               const block& next = at(n);
+               if (!confirming[next.schedule_version].insert(next.signed_header.header.producer).second) {
+                  ids.push_back(next.id);
+                  continue;
+               }
+               bridgetypes::sblockheader bft = next.signed_header;
+               for (const auto& node : proofcheck::merkle_path(ids, block_num - 1)) bft.bmproofpath.push_back(hash_index(node));
+               proof.bftproof.push_back(std::move(bft));
+               ids.push_back(next.id);
+            }
+            check(confirmed(), "not enough blocks produced to confirm the block");
+
+            return proof;
+         }
+
+         // proof of `block_num` against the block root of `anchor_num`, as proven by a heavy proof of `anchor_num`
+         bridgetypes::lightproof light_proof(const uint32_t block_num, const uint32_t anchor_num) const {
+            check(block_num <= anchor_num && anchor_num <= _blocks.size(), "block must not be above its anchor");
+
+            std::vector<checksum256> ids = block_ids(anchor_num);
+
+            return { _chain_id, at(block_num).signed_header.header, digests::merkle(ids), proofcheck::merkle_path(ids, block_num - 1) };
+         }
+
+         // proof of the `index`th action of `block_num`
+         bridgetypes::actionproof action_proof(const uint32_t block_num, const size_t index) const {
+            const block& b = at(block_num);
+            check(index < b.actions.size(), "no such action in block");
+
+            std::vector<checksum256> receipt_digests;
+            for (const auto& a : b.actions) receipt_digests.push_back(digests::of(a.receipt));
+
+            bridgetypes::actionproof proof = b.actions[index];
+            proof.amproofpath = proofcheck::merkle_path(receipt_digests, index);
+            return proof;
+         }
+
+         // actions of `block_num` at `indices` (ascending) with one multiproof of their receipts, for `withdrawm`
+         std::pair<std::vector<bridgetypes::actionproof>, proofcheck::multiproof> action_multiproof(const uint32_t block_num, const std::vector<uint32_t>& indices) const {
+            const block& b = at(block_num);
+
+            std::vector<checksum256> receipt_digests;
+            for (const auto& a : b.actions) receipt_digests.push_back(digests::of(a.receipt));
+
+            auto proof = proofcheck::make_multiproof(receipt_digests, indices);
+            std::vector<bridgetypes::actionproof> actions;
+            for (auto i : proof.indices) {
+               check(i < b.actions.size(), "no such action in block");
+               actions.push_back(b.actions[i]);
+            }
+            return { actions, proof };
+         }
+
+      private:
+         struct block {
+            bridgetypes::sblockheader                  signed_header;
+            checksum256                                id;
+            uint32_t                                   schedule_version;
+            proofcheck::incremental_merkle             block_merkle;   // over the blocks before this one
+            std::vector<bridgetypes::actionproof>      actions;        // without their paths
+         };
+
+         const block& at(const uint32_t block_num) const {
+            check(block_num >= 1 && block_num <= _blocks.size(), "no such block");
+            return _blocks[block_num - 1];
+         }
+
+         // ids of the first `count` blocks, the leaves of the block merkle tree
+         std::vector<checksum256> block_ids(const uint32_t count) const {
+            std::vector<checksum256> ids;
+            for (uint32_t n = 1; n <= count; n++) ids.push_back(at(n).id);
+            return ids;
+         }
+
+         checksum256                                                          _chain_id;
+         uint32_t                                                             _return_value_activated;
+         uint32_t                                                             _blocks_per_producer;
+         signer                                                               _sign;
+         time_point_sec                                                       _genesis;
+         bridgetypes::schedulev2                                              _schedule;
+         std::map<uint32_t, bridgetypes::schedulev2>                          _schedules;
+         std::optional<bridgetypes::schedulev2>                               _proposed;           // announced in the next block
+         std::optional<std::pair<uint32_t, bridgetypes::schedulev2>>          _pending_schedule;   // activation block and schedule
+         std::vector<std::pair<action, std::vector<char>>>                    _pending;
+         std::vector<block>                                                   _blocks;
+         proofcheck::incremental_merkle                                       _block_merkle;
+         uint64_t                                                             _global_sequence = 0;
+         std::map<name, uint64_t>                                             _recv_sequence;
+         std::map<name, uint64_t>                                             _auth_sequence;
+   };
+
+   class mock_bridge {
+      public:
+         using recovery = std::function<public_key(const checksum256&, const signature&)>;
+
+         mock_bridge(const checksum256& chain_id, const uint32_t return_value_activated, const bridgetypes::schedulev2& initial_schedule, recovery recover = test_recover) {
+            _config.chain_id = chain_id;
+            _config.return_value_activated = return_value_activated;
+            _config.recover = std::move(recover);
+            add_schedule(initial_schedule);
+         }
+
+         explicit mock_bridge(const chain& c, recovery recover = test_recover)
+         : mock_bridge(c.chain_id(), c.return_value_activated(), c.schedule(0), std::move(recover)) {}
+
+         void add_schedule(const bridgetypes::schedulev2& schedule) { _config.schedules[schedule.version] = to_schedule(schedule); }
+
+         // block only heavy proof, as `checkproofa` / `checkproofd`
+         proofcheck::result checkproofa(const bridgetypes::heavyproof& blockproof) { return checkproofd(blockproof); }
+
+         proofcheck::result checkproofd(const bridgetypes::heavyproof& blockproof) {
+            if (auto r = proofcheck::check_block_proof(_config, blockproof)) return r;
+            return accept(blockproof);
+         }
+
+         // heavy proof of an action, as `checkproofb` / `checkproofe`: the bridge runs both through `_checkproofb`,
+         // `checkproofb` only reads the block proof staged by the calling contract instead of taking it as an argument
+         proofcheck::result checkproofb(const bridgetypes::heavyproof& blockproof, const bridgetypes::actionproof& actionproof) { return checkproofe(blockproof, actionproof); }
+
+         // light proof of an action, as `checkproofc` / `checkprooff`, both `_checkproofc` on the bridge
+         proofcheck::result checkproofc(const bridgetypes::lightproof& blockproof, const bridgetypes::actionproof& actionproof) { return checkprooff(blockproof, actionproof); }
+
+         // heavy proof of an action, as `checkproofe`
+         proofcheck::result checkproofe(const bridgetypes::heavyproof& blockproof, const bridgetypes::actionproof& actionproof) {
+            if (auto r = proofcheck::check_heavy_proof(_config, blockproof, actionproof)) return r;
+            return accept(blockproof);
+         }
+
+         // light proof of an action, as `checkprooff`
+         proofcheck::result checkprooff(const bridgetypes::lightproof& blockproof, const bridgetypes::actionproof& actionproof) {
+            return proofcheck::check_light_proof(_config, blockproof, actionproof);
+         }
+
+         const std::set<checksum256>& proven_roots() const { return _config.proven_roots; }
+
+      private:
+         // records the block root including the proven block, and any schedule change it announces
+         proofcheck::result accept(const bridgetypes::heavyproof& blockproof) {
+            const auto& anchor = blockproof.blocktoprove;
+
+            proofcheck::incremental_merkle m;
+            for (auto i : anchor.active_nodes) m.active_nodes.push_back(blockproof.hashes[i]);   // checked by check_block_proof
+            m.node_count = anchor.node_count;
+            m.append(proofcheck::block_id(anchor.block.header));
+            _config.proven_roots.insert(m.root());
+
+            if (auto s = proofcheck::announced_schedule(anchor.block.header)) _config.schedules[s->version] = *s;
+            return nullptr;
+         }
+
+         proofcheck::chain_config                        _config;
+   };
+
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+// Per-stage profiling of the contract hot paths.
+//
+// In native builds with WRAPLOCK_PROFILING set, stages marked with WRAPLOCK_PROFILE_STAGE (enclosing scope) or
+// WRAPLOCK_PROFILE_BEGIN / WRAPLOCK_PROFILE_END are timed, and the allocations made within them counted once
+// WRAPLOCK_PROFILING_DEFINE_ALLOCATOR() has been placed in one translation unit. `profiling::collector::instance()`
+// writes the totals in folded stack format, the input of flamegraph.pl, inferno and speedscope.
+//
+// The contract is built natively by the host test project (tests/CMakeLists.txt), where WRAPLOCK_PROFILING=ON adds the
+// `wraplock_profile` workload writing `wraplock.folded`. Otherwise the macros expand to nothing, the production wasm
+// carries no trace of them.
+
+#ifndef WRAPLOCK_PROFILING
+#define WRAPLOCK_PROFILING 0
+#endif
+
+#if WRAPLOCK_PROFILING && !defined(__wasm__)
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace profiling {
+
+   struct totals {
+      uint64_t calls = 0;
+      uint64_t nanoseconds = 0;
+      uint64_t allocations = 0;
+      uint64_t allocated_bytes = 0;
+   };
+
+   // allocation counters of the current thread, advanced by the allocator hooks
+   inline thread_local uint64_t allocations = 0;
+   inline thread_local uint64_t allocated_bytes = 0;
+
+   class collector {
+      public:
+         enum class metric { nanoseconds, allocations, allocated_bytes };
+
+         static collector& instance() {
+            static collector c;
+            return c;
+         }
+
+         // the profiler's own allocations are taken back out of the counters, so they are not charged to any stage
+         void begin(const char* stage) {
+            uint64_t a = allocations, b = allocated_bytes;
+
+            frame f;
+            f.path = _stack.empty() ? std::string(stage) : _stack.back().path + ";" + stage;
+            f.allocations = a;
+            f.allocated_bytes = b;
+            _stack.push_back(std::move(f));
+
+            allocations = a;
+            allocated_bytes = b;
+            _stack.back().start = std::chrono::steady_clock::now();
+         }
+
+         void end() {
+            if (_stack.empty()) return;
+            auto elapsed = std::chrono::steady_clock::now() - _stack.back().start;
+            uint64_t a = allocations, b = allocated_bytes;
+
+            {
+               std::lock_guard<std::mutex> g(_lock);
+               auto& t = _totals[_stack.back().path];
+               t.calls++;
+               t.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+               t.allocations += a - _stack.back().allocations;
+               t.allocated_bytes += b - _stack.back().allocated_bytes;
+            }
+            _stack.pop_back();
+
+            allocations = a;
+            allocated_bytes = b;
+         }
+
+         // drops the frames above `depth` without recording them, for stages left open by an exception
+         void unwind(const size_t depth) {
+            while (_stack.size() > depth) _stack.pop_back();
+         }
+
+         size_t depth() const { return _stack.size(); }
+
+         std::map<std::string, totals> snapshot() {
+            std::lock_guard<std::mutex> g(_lock);
+            return _totals;
+         }
+
+         void reset() {
+            std::lock_guard<std::mutex> g(_lock);
+            _totals.clear();
+         }
+
+         // one `stage;substage value` line per stack, values exclusive of nested stages as flamegraph tools expect
+         void write_folded(FILE* out, const metric m = metric::nanoseconds) {
+            auto all = snapshot();
+            auto value = [&](const totals& t) {
+               switch (m) {
+                  case metric::allocations: return t.allocations;
+                  case metric::allocated_bytes: return t.allocated_bytes;
+                  default: return t.nanoseconds;
+               }
+            };
+
+            for (const auto& [path, t] : all) {
+               uint64_t self = value(t);
+               for (auto child = all.upper_bound(path + ";"); child != all.end() && child->first.compare(0, path.size() + 1, path + ";") == 0; child++) {
+                  if (child->first.find(';', path.size() + 1) != std::string::npos) continue; // only direct children
+                  uint64_t v = value(child->second);
+                  self = self > v ? self - v : 0;
+               }
+               fprintf(out, "%s %llu\n", path.c_str(), (unsigned long long)self);
+            }
+         }
+
+      private:
+         struct frame {
+            std::string                                  path;
+            std::chrono::steady_clock::time_point        start;
+            uint64_t                                     allocations;
+            uint64_t                                     allocated_bytes;
+         };
+
+         static inline thread_local std::vector<frame>   _stack;
+
+         std::mutex                                      _lock;
+         std::map<std::string, totals>                   _totals;
+   };
+
+   // times the enclosing scope, closing any WRAPLOCK_PROFILE_BEGIN left open inside it (e.g. by a failed check)
+   struct scope {
+      explicit scope(const char* stage) : _depth(collector::instance().depth()) { collector::instance().begin(stage); }
+      ~scope() {
+         collector::instance().unwind(_depth + 1);
+         collector::instance().end();
+      }
+
+      size_t _depth;
+   };
+
+}
+
+#define WRAPLOCK_PROFILE_CONCAT_(a, b) a##b
+#define WRAPLOCK_PROFILE_CONCAT(a, b) WRAPLOCK_PROFILE_CONCAT_(a, b)
+
+#define WRAPLOCK_PROFILE_STAGE(stage) ::profiling::scope WRAPLOCK_PROFILE_CONCAT(_profile_scope_, __LINE__)(stage)
+#define WRAPLOCK_PROFILE_BEGIN(stage) ::profiling::collector::instance().begin(stage)
+#define WRAPLOCK_PROFILE_END() ::profiling::collector::instance().end()
+
+// replaces the global allocator to count allocations per stage, to be used in exactly one translation unit
+#define WRAPLOCK_PROFILING_DEFINE_ALLOCATOR() \
+   void* operator new(std::size_t size) { \
+      ::profiling::allocations++; \
+      ::profiling::allocated_bytes += size; \
+      if (void* p = std::malloc(size ? size : 1)) return p; \
+      throw std::bad_alloc(); \
+   } \
+   void operator delete(void* p) noexcept { std::free(p); } \
+   void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+#else
+
+#define WRAPLOCK_PROFILE_STAGE(stage)
+#define WRAPLOCK_PROFILE_BEGIN(stage)
+#define WRAPLOCK_PROFILE_END()
+#define WRAPLOCK_PROFILING_DEFINE_ALLOCATOR()
+
+#endif
@@ -0,0 +1,570 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+#ifndef __wasm__
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <variant>
+#endif
+
+#include <bridge_types.hpp>
+
+// Offline pre-verification of bridge proofs, mirroring the checks performed by the bridge for heavy proofs (`checkproofb`
+// and `checkproofe`) and light proofs (`checkproofc` and `checkprooff`). Relayers use it to only submit proofs that will
+// pass on chain. Action digests include the return value from the chain's `return_value_activated` block on, whichever
+// entry point is used.
+//
+// Hashing goes through the sha256 intrinsic when compiled to wasm and a portable implementation in native builds.
+// Key recovery is supplied by the caller in native builds, as there is no recover_key intrinsic outside the chain.
+// Wasm builds only get the hashing and merkle helpers used by the contract, the proof checks are host side.
+//
+// The bridge remains authoritative, a proof passing here can still be rejected on chain (e.g. expired schedule).
+
+namespace proofcheck {
+
+   using namespace eosio;
+
+   //producer_schedule_change_extension, carries the new schedule (v2) in the header announcing it
+   inline constexpr uint16_t SCHEDULE_CHANGE_EXTENSION = 1;
+
+#ifdef __wasm__
+
+   inline checksum256 hash(const char* data, size_t size) { return sha256(data, size); }
+
+#else
+
+   //portable sha256, the sha256 intrinsic is only available on chain
+   inline checksum256 hash(const char* data, size_t size) {
+
+      static constexpr uint32_t k[64] = {
+         0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+         0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+         0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+         0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+         0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+         0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+         0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+         0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+
+      uint32_t h[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+      auto rotr = [](uint32_t x, int n) { return (x >> n) | (x << (32 - n)); };
+
+      auto compress = [&](const uint8_t* block) {
+         uint32_t w[64];
+         for (int i = 0; i < 16; i++) w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16) | (uint32_t(block[i * 4 + 2]) << 8) | block[i * 4 + 3];
+         for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+         }
+         uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+         for (int i = 0; i < 64; i++) {
+            uint32_t t1 = hh + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            hh = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+         }
+         h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+      };
+
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+      size_t full = size / 64;
+      for (size_t i = 0; i < full; i++) compress(bytes + i * 64);
+
+      //padding: remaining bytes, 0x80, zeroes, then the bit length as big endian
+      uint8_t tail[128] = {0};
+      size_t rem = size - full * 64;
+      memcpy(tail, bytes + full * 64, rem);
+      tail[rem] = 0x80;
+      size_t tail_size = rem < 56 ? 64 : 128;
+      uint64_t bits = uint64_t(size) * 8;
+      for (int i = 0; i < 8; i++) tail[tail_size - 1 - i] = uint8_t(bits >> (i * 8));
+      compress(tail);
+      if (tail_size == 128) compress(tail + 64);
+
+      std::array<uint8_t, 32> out;
+      for (int i = 0; i < 8; i++) {
+         out[i * 4] = uint8_t(h[i] >> 24);
+         out[i * 4 + 1] = uint8_t(h[i] >> 16);
+         out[i * 4 + 2] = uint8_t(h[i] >> 8);
+         out[i * 4 + 3] = uint8_t(h[i]);
+      }
+      return checksum256(out);
+
+   }
+
+#endif
+
+   template<typename T>
+   checksum256 hash_of(const T& value) {
+      std::vector<char> serialized = pack(value);
+      return hash(serialized.data(), serialized.size());
+   }
+
+   //hash of the concatenation of two digests
+   inline checksum256 hash_concat(const checksum256& a, const checksum256& b) {
+      std::array<uint8_t, 64> buf;
+      auto ab = a.extract_as_byte_array();
+      auto bb = b.extract_as_byte_array();
+      std::copy(ab.begin(), ab.end(), buf.begin());
+      std::copy(bb.begin(), bb.end(), buf.begin() + 32);
+      return hash(reinterpret_cast<const char*>(buf.data()), buf.size());
+   }
+
+   inline checksum256 make_canonical_left(const checksum256& value) {
+      auto b = value.extract_as_byte_array();
+      b[0] &= 0x7f;
+      return checksum256(b);
+   }
+
+   inline checksum256 make_canonical_right(const checksum256& value) {
+      auto b = value.extract_as_byte_array();
+      b[0] |= 0x80;
+      return checksum256(b);
+   }
+
+   inline bool is_canonical_left(const checksum256& value) { return (value.extract_as_byte_array()[0] & 0x80) == 0; }
+
+   //merkle node from its two children, as in the chain's canonical merkle trees
+   inline checksum256 hash_pair(const checksum256& left, const checksum256& right) {
+      return hash_concat(make_canonical_left(left), make_canonical_right(right));
+   }
+
+   //folds a canonical merkle path onto a leaf, the side of each sibling is encoded in its leading bit
+   inline checksum256 compute_root(const std::vector<checksum256>& path, const checksum256& leaf) {
+      checksum256 node = leaf;
+      for (const auto& sibling : path) {
+         node = is_canonical_left(sibling) ? hash_pair(sibling, node) : hash_pair(node, sibling);
+      }
+      return node;
+   }
+
+   //root of the chain's legacy merkle tree over `nodes`: levels of odd size repeat their last node
+   inline checksum256 merkle_root(std::vector<checksum256> nodes) {
+      if (nodes.empty()) return checksum256();
+      while (nodes.size() > 1) {
+         if (nodes.size() % 2) nodes.push_back(nodes.back());
+         for (size_t i = 0; i < nodes.size() / 2; i++) nodes[i] = hash_pair(nodes[2 * i], nodes[2 * i + 1]);
+         nodes.resize(nodes.size() / 2);
+      }
+      return nodes[0];
+   }
+
+#ifndef __wasm__
+   //canonical path from leaf `index` to the merkle_root of `nodes`, as folded by compute_root
+   inline std::vector<checksum256> merkle_path(std::vector<checksum256> nodes, size_t index) {
+      std::vector<checksum256> path;
+      while (nodes.size() > 1) {
+         if (nodes.size() % 2) nodes.push_back(nodes.back());
+         path.push_back(index % 2 ? make_canonical_left(nodes[index - 1]) : make_canonical_right(nodes[index + 1]));
+         for (size_t i = 0; i < nodes.size() / 2; i++) nodes[i] = hash_pair(nodes[2 * i], nodes[2 * i + 1]);
+         nodes.resize(nodes.size() / 2);
+         index /= 2;
+      }
+      return path;
+   }
+#endif
+
+   // Paths of several leaves of the same merkle tree, sharing their common siblings. `hashes` holds, level by level
+   // from the leaves up, the siblings that cannot be computed from the proven leaves, in ascending position order.
+   struct multiproof {
+      uint32_t                      leaf_count;   // leaves in the tree, e.g. action receipts in the block
+      std::vector<uint32_t>         indices;      // positions of the proven leaves, strictly ascending
+      std::vector<checksum256>      hashes;
+
+      EOSLIB_SERIALIZE( multiproof, (leaf_count)(indices)(hashes) )
+   };
+
+   //merkle_root of the tree holding `leaves` at `proof.indices`, in a single pass; empty if the proof is malformed
+   inline std::optional<checksum256> multiproof_root(const multiproof& proof, const std::vector<checksum256>& leaves) {
+      if (proof.leaf_count == 0 || proof.indices.empty() || proof.indices.size() != leaves.size()) return std::nullopt;
+      for (size_t i = 1; i < proof.indices.size(); i++) if (proof.indices[i - 1] >= proof.indices[i]) return std::nullopt;
+      if (proof.indices.back() >= proof.leaf_count) return std::nullopt;
+
+      std::vector<std::pair<uint32_t, checksum256>> nodes;
+      for (size_t i = 0; i < leaves.size(); i++) nodes.push_back({ proof.indices[i], leaves[i] });
+
+      size_t next_hash = 0;
+      for (uint32_t level_size = proof.leaf_count; level_size > 1; level_size = (level_size + 1) / 2) {
+         size_t parents = 0;
+         for (size_t k = 0; k < nodes.size(); parents++) {
+            auto [position, node] = nodes[k++];
+            checksum256 parent;
+            if (position % 2 == 0 && position + 1 == level_size) parent = hash_pair(node, node);   // odd level, last node repeated
+            else if (position % 2 == 0 && k < nodes.size() && nodes[k].first == position + 1) parent = hash_pair(node, nodes[k++].second);
+            else {
+               if (next_hash == proof.hashes.size()) return std::nullopt;
+               const checksum256& sibling = proof.hashes[next_hash++];
+               parent = position % 2 ? hash_pair(sibling, node) : hash_pair(node, sibling);
+            }
+            nodes[parents] = { position / 2, parent };
+         }
+         nodes.resize(parents);
+      }
+      if (next_hash != proof.hashes.size()) return std::nullopt;
+
+      return nodes[0].second;
+   }
+
+#ifndef __wasm__
+   //multiproof of the leaves at `indices` (host side)
+   inline multiproof make_multiproof(std::vector<checksum256> level, std::vector<uint32_t> indices) {
+      std::sort(indices.begin(), indices.end());
+      indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+      multiproof proof{ uint32_t(level.size()), indices, {} };
+      while (level.size() > 1) {
+         size_t level_size = level.size();
+         if (level_size % 2) level.push_back(level.back());
+
+         std::vector<uint32_t> parents;
+         for (size_t k = 0; k < indices.size(); k++) {
+            uint32_t sibling = indices[k] ^ 1;
+            bool repeated = sibling == level_size;
+            bool known = (indices[k] % 2 == 0 && k + 1 < indices.size() && indices[k + 1] == sibling) || (indices[k] % 2 == 1 && k > 0 && indices[k - 1] == sibling);
+            if (!known && !repeated) proof.hashes.push_back(level[sibling]);
+            if (parents.empty() || parents.back() != indices[k] / 2) parents.push_back(indices[k] / 2);
+         }
+
+         for (size_t i = 0; i < level.size() / 2; i++) level[i] = hash_pair(level[2 * i], level[2 * i + 1]);
+         level.resize(level.size() / 2);
+         indices = std::move(parents);
+      }
+      return proof;
+   }
+#endif
+
+   inline checksum256 header_digest(const bridgetypes::blockheader& header) { return hash_of(header); }
+
+   inline checksum256 block_id(const bridgetypes::blockheader& header) { return bridgetypes::compute_block_id(header_digest(header), header.block_num()); }
+
+   //digest of an action as stored in its receipt, return values are part of it once ACTION_RETURN_VALUE is active
+   inline checksum256 action_digest(const action& act, const std::vector<char>& returnvalue, const bool return_value_activated) {
+      if (!return_value_activated) return hash_of(act);
+
+      checksum256 base = hash_of(std::make_tuple(act.account, act.name, act.authorization));
+      checksum256 data = hash_of(std::make_tuple(act.data, returnvalue));
+      return hash_concat(base, data);
+   }
+
+   inline checksum256 receipt_digest(const bridgetypes::actreceipt& receipt) { return hash_of(receipt); }
+
+#ifndef __wasm__
+   //digest signed by the producer of a block: hash(hash(header digest, block merkle root), pending schedule hash)
+   inline checksum256 signing_digest(const checksum256& header_digest, const checksum256& bmroot, const checksum256& schedule_hash) {
+      return hash_concat(hash_concat(header_digest, bmroot), schedule_hash);
+   }
+
+   //producer schedule known to the relayer, mirroring the bridge `schedules` table
+   struct schedule {
+      uint32_t                        version = 0;
+      std::vector<producer_authority> producers;
+      checksum256                     hash;         // as signed over while the schedule is the latest proposed one
+   };
+
+   //schedule announced by `header`, through the schedule change extension or the legacy `new_producers` field
+   inline std::optional<schedule> announced_schedule(const bridgetypes::blockheader& header) {
+      for (const auto& [id, data] : header.header_extensions) {
+         if (id != SCHEDULE_CHANGE_EXTENSION) continue;
+         auto s = unpack<bridgetypes::schedulev2>(data);
+         return schedule{ s.version, s.producers, hash_of(s) };
+      }
+      if (!header.new_producers) return std::nullopt;
+
+      schedule s{ header.new_producers->version, {}, hash_of(*header.new_producers) };
+      for (const auto& p : header.new_producers->producers) {
+         s.producers.push_back(producer_authority{ p.producer_name, block_signing_authority_v0{ 1, { key_weight{ p.block_signing_key, 1 } } } });
+      }
+      return s;
+   }
+
+   // Incremental form of merkle_root, as kept by block producers for the block merkle tree. The active nodes are,
+   // from the bottom: the complete node at the lowest level where the next leaf starts a new pair (absent when the
+   // tree is full), the left siblings still waiting for a right one above it, then the root.
+   struct incremental_merkle {
+      std::vector<checksum256>      active_nodes;
+      uint64_t                      node_count = 0;
+
+      static uint64_t max_depth(uint64_t count) {
+         if (count == 0) return 0;
+         uint64_t depth = 1;
+         for (uint64_t implied = 1; implied < count; implied <<= 1) depth++;
+         return depth;
+      }
+
+      checksum256 append(const checksum256& digest) {
+         bool partial = false;
+         uint64_t depth = max_depth(node_count + 1) - 1;
+         uint64_t index = node_count;
+         checksum256 top = digest;
+         auto active = active_nodes.begin();
+
+         std::vector<checksum256> updated;
+         while (depth > 0) {
+            if (!(index & 1)) {
+               if (!partial) updated.push_back(top);
+               top = hash_pair(top, top);
+               partial = true;
+            }
+            else {
+               const checksum256 left = *active++;
+               if (partial) updated.push_back(left);
+               top = hash_pair(left, top);
+            }
+            depth--;
+            index >>= 1;
+         }
+         updated.push_back(top);
+
+         active_nodes = std::move(updated);
+         node_count++;
+         return top;
+      }
+
+      checksum256 root() const { return node_count > 0 && !active_nodes.empty() ? active_nodes.back() : checksum256(); }
+
+      //true if the root follows from the other active nodes, so they can be trusted for `append`
+      bool valid() const {
+         if (node_count == 0) return active_nodes.empty();
+
+         uint64_t depth = max_depth(node_count) - 1;
+         uint64_t index = node_count - 1;
+         while (depth > 0 && (index & 1)) {   // levels folded into the first active node
+            depth--;
+            index >>= 1;
+         }
+         if (depth == 0) return active_nodes.size() == 1;
+
+         auto active = active_nodes.begin();
+         checksum256 top = *active++;
+         while (depth > 0) {
+            if (!(index & 1)) top = hash_pair(top, top);
+            else {
+               if (active == active_nodes.end()) return false;
+               top = hash_pair(*active++, top);
+            }
+            depth--;
+            index >>= 1;
+         }
+         return active != active_nodes.end() && active + 1 == active_nodes.end() && *active == top;
+      }
+   };
+
+   //verification settings for one paired chain, mirroring the bridge `chains` and `lastproofs` tables
+   struct chain_config {
+      checksum256                                                              chain_id;
+      uint32_t                                                                 return_value_activated = 0;   // first block with return values in action digests, 0 if never
+      std::map<uint32_t, schedule>                                             schedules;   // by version
+      std::set<checksum256>                                                    proven_roots;
+      std::function<public_key(const checksum256&, const signature&)>          recover;
+   };
+
+   // Every check returns nullptr on success, or the reason the proof would be rejected.
+   using result = const char*;
+
+   inline result check_action_proof(const chain_config& config, const bridgetypes::blockheader& header, const bridgetypes::actionproof& actionproof) {
+
+      bool rv_active = config.return_value_activated != 0 && header.block_num() >= config.return_value_activated;
+
+      if (action_digest(actionproof.action, actionproof.returnvalue, rv_active) != actionproof.receipt.act_digest) return "action digest does not match receipt";
+
+      checksum256 receipt = receipt_digest(actionproof.receipt);
+      if (compute_root(actionproof.amproofpath, receipt) != header.action_mroot) return "action merkle path does not match action_mroot";
+
+      return nullptr;
+   }
+
+   //schedule `version` among the known ones, or those announced by earlier blocks of the same proof
+   inline const schedule* find_schedule(const chain_config& config, const std::map<uint32_t, schedule>& announced, const uint32_t version) {
+      auto s = config.schedules.find(version);
+      if (s != config.schedules.end()) return &s->second;
+      auto a = announced.find(version);
+      return a != announced.end() ? &a->second : nullptr;
+   }
+
+   // `digest_of_header` is the header digest of `block`, computed once by the caller.
+   // The producer signs over the latest proposed schedule: the one the block announces, otherwise its own schedule or,
+   // while a change is pending, the next one.
+   inline result check_signatures(const chain_config& config, const std::map<uint32_t, schedule>& announced, const bridgetypes::sblockheader& block, const checksum256& digest_of_header) {
+
+      const schedule* active = find_schedule(config, announced, block.header.schedule_version);
+      if (!active) return "unknown producer schedule";
+
+      auto producer = std::find_if(active->producers.begin(), active->producers.end(), [&](const auto& p) { return p.producer_name == block.header.producer; });
+      if (producer == active->producers.end()) return "producer not in schedule";
+      const auto& auth = std::get<block_signing_authority_v0>(producer->authority);
+
+      std::vector<checksum256> schedule_hashes;
+      if (auto s = announced_schedule(block.header)) schedule_hashes.push_back(s->hash);
+      else {
+         schedule_hashes.push_back(active->hash);
+         if (auto next = find_schedule(config, announced, block.header.schedule_version + 1)) schedule_hashes.push_back(next->hash);
+      }
+
+      for (const auto& schedule_hash : schedule_hashes) {
+         checksum256 digest = signing_digest(digest_of_header, block.previous_bmroot, schedule_hash);
+         uint32_t weight = 0;
+         for (const auto& sig : block.producer_signatures) {
+            public_key key = config.recover(digest, sig);
+            for (const auto& kw : auth.keys) if (kw.key == key) weight += kw.weight;
+         }
+         if (weight >= auth.threshold) return nullptr;
+      }
+      return "insufficient producer signature weight";
+   }
+
+   inline result check_signatures(const chain_config& config, const bridgetypes::sblockheader& block) {
+      return check_signatures(config, {}, block, header_digest(block.header));
+   }
+
+   // Mirrors `checkproofa`: the signed block, its incremental block merkle (`hashes` indexed by `active_nodes`) against
+   // its previous_bmroot, then signed bft blocks each linking back to it through a path (`hashes` indexed by
+   // `bmproofpath`) to their own previous_bmroot, until 2/3+1 of the producers of one schedule have signed.
+   // Bft blocks may be signed under a schedule announced earlier in the proof.
+   inline result check_block_proof(const chain_config& config, const bridgetypes::heavyproof& blockproof) {
+
+      if (blockproof.chain_id != config.chain_id) return "proof chain does not match paired chain";
+
+      const auto& anchor = blockproof.blocktoprove;
+      const auto& block = anchor.block;
+      checksum256 digest = header_digest(block.header);
+      std::map<uint32_t, schedule> announced;
+      if (auto r = check_signatures(config, announced, block, digest)) return r;
+      if (auto s = announced_schedule(block.header)) announced[s->version] = *s;
+
+      incremental_merkle merkle;
+      merkle.node_count = anchor.node_count;
+      for (auto i : anchor.active_nodes) {
+         if (i >= blockproof.hashes.size()) return "invalid active node";
+         merkle.active_nodes.push_back(blockproof.hashes[i]);
+      }
+      if (merkle.node_count != uint64_t(block.header.block_num()) - 1 || !merkle.valid()) return "invalid incremental merkle";
+      if (merkle.root() != block.previous_bmroot) return "incremental merkle does not match previous_bmroot";
+
+      checksum256 id = bridgetypes::compute_block_id(digest, block.header.block_num());
+
+      std::map<uint32_t, std::set<name>> confirming;
+      confirming[block.header.schedule_version].insert(block.header.producer);
+      uint32_t last_num = block.header.block_num();
+      for (const auto& bft : blockproof.bftproof) {
+         if (bft.header.block_num() <= last_num) return "bft proof blocks must be in ascending order";
+
+         std::vector<checksum256> path;
+         for (auto i : bft.bmproofpath) {
+            if (i >= blockproof.hashes.size()) return "invalid bft merkle path node";
+            path.push_back(blockproof.hashes[i]);
+         }
+         if (compute_root(path, id) != bft.previous_bmroot) return "bft block does not confirm the proven block";
+
+         if (auto r = check_signatures(config, announced, bft, header_digest(bft.header))) return r;
+         if (auto s = announced_schedule(bft.header)) announced[s->version] = *s;
+         confirming[bft.header.schedule_version].insert(bft.header.producer);
+         last_num = bft.header.block_num();
+      }
+
+      // only known schedules count, a schedule announced in the proof is not yet confirmed itself
+      bool confirmed = std::any_of(confirming.begin(), confirming.end(), [&](const auto& c) {
+         auto s = config.schedules.find(c.first);
+         return s != config.schedules.end() && c.second.size() >= s->second.producers.size() * 2 / 3 + 1;
+      });
+      if (!confirmed) return "not enough producers confirming block";
+
+      return nullptr;
+   }
+
+   //mirrors `checkproofb` / `checkproofe`: the block as for `checkproofa`, then the action itself
+   inline result check_heavy_proof(const chain_config& config, const bridgetypes::heavyproof& blockproof, const bridgetypes::actionproof& actionproof) {
+      if (auto r = check_block_proof(config, blockproof)) return r;
+      return check_action_proof(config, blockproof.blocktoprove.block.header, actionproof);
+   }
+
+   //mirrors `checkproofc` / `checkprooff`: block id against a root already proven on the bridge, then the action itself
+   inline result check_light_proof(const chain_config& config, const bridgetypes::lightproof& blockproof, const bridgetypes::actionproof& actionproof) {
+
+      if (blockproof.chain_id != config.chain_id) return "proof chain does not match paired chain";
+      if (config.proven_roots.count(blockproof.root) == 0) return "root not proven on bridge";
+
+      checksum256 id = block_id(blockproof.header);
+      if (compute_root(blockproof.bmproofpath, id) != blockproof.root) return "block merkle path does not match root";
+
+      return check_action_proof(config, blockproof.header, actionproof);
+   }
+
+   struct job {
+      std::variant<bridgetypes::heavyproof, bridgetypes::lightproof>  blockproof;
+      bridgetypes::actionproof                                   actionproof;
+   };
+
+   // Verifies a batch of proofs on `threads` workers. Jobs are dealt round robin to per-worker queues, a worker takes
+   // from the back of its own queue and steals from the front of the others once it runs dry, so uneven proof sizes
+   // (long bft proofs next to light proofs) do not leave workers idle.
+   inline std::vector<result> verify_batch(const chain_config& config, const std::vector<job>& jobs, size_t threads = std::thread::hardware_concurrency()) {
+
+      std::vector<result> results(jobs.size(), nullptr);
+      if (threads == 0) threads = 1;
+      threads = std::min(threads, std::max<size_t>(jobs.size(), 1));
+
+      struct queue {
+         std::mutex          lock;
+         std::deque<size_t>  items;
+      };
+      std::vector<queue> queues(threads);
+      for (size_t i = 0; i < jobs.size(); i++) queues[i % threads].items.push_back(i);
+
+      auto next = [&](size_t self) -> std::optional<size_t> {
+         {
+            std::lock_guard<std::mutex> g(queues[self].lock);
+            if (!queues[self].items.empty()) {
+               size_t i = queues[self].items.back();
+               queues[self].items.pop_back();
+               return i;
+            }
+         }
+         for (size_t n = 1; n < threads; n++) {
+            auto& victim = queues[(self + n) % threads];
+            std::lock_guard<std::mutex> g(victim.lock);
+            if (!victim.items.empty()) {
+               size_t i = victim.items.front();
+               victim.items.pop_front();
+               return i;
+            }
+         }
+         return std::nullopt;
+      };
+
+      // a malformed proof can throw while being decoded (e.g. a bad schedule extension), it fails alone
+      auto work = [&](size_t self) {
+         while (auto i = next(self)) {
+            const auto& j = jobs[*i];
+            try {
+               results[*i] = std::visit([&](const auto& blockproof) -> result {
+                  if constexpr (std::is_same_v<std::decay_t<decltype(blockproof)>, bridgetypes::heavyproof>) return check_heavy_proof(config, blockproof, j.actionproof);
+                  else return check_light_proof(config, blockproof, j.actionproof);
+               }, j.blockproof);
+            }
+            catch (...) {
+               results[*i] = "proof verification threw";
+            }
+         }
+      };
+
+      std::vector<std::thread> workers;
+      for (size_t t = 1; t < threads; t++) workers.emplace_back(work, t);
+      work(0);
+      for (auto& w : workers) w.join();
+
+      return results;
+   }
+
+#endif
+
+}
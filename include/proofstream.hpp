@@ -0,0 +1,140 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/time.hpp>
+
+#include <bridge_types.hpp>
+#include <proofcheck.hpp>
+
+// Walks serialized bridge proof structures in place, reading only the fields needed and skipping over the rest
+// without decoding it. Layouts follow the EOSLIB_SERIALIZE definitions in bridge_types.hpp.
+//
+// Skipping only checks vector lengths against the bytes left, callers must check `ds.valid()` once done.
+
+namespace proofstream {
+
+   using namespace eosio;
+
+   template<typename DS>
+   uint32_t read_varuint(DS& ds) {
+      unsigned_int v;
+      ds >> v;
+      return v.value;
+   }
+
+   //vector of fixed size elements, e.g. checksum256 (32) or uint16_t (2)
+   //a length beyond the bytes left leaves the stream invalid rather than wrapping the skipped size
+   template<typename DS>
+   void skip_vector(DS& ds, const size_t element_size) {
+      if (!ds.valid()) return;
+      size_t count = read_varuint(ds);
+      if (count > ds.remaining() / element_size) ds.skip(ds.remaining() + 1);
+      else ds.skip(count * element_size);
+   }
+
+   //std::vector<char>, std::string
+   template<typename DS>
+   void skip_bytes(DS& ds) { skip_vector(ds, 1); }
+
+   //public_key variant: K1 / R1 compressed keys, or WA key with user presence and relying party id
+   template<typename DS>
+   void skip_public_key(DS& ds) {
+      uint32_t type = read_varuint(ds);
+      ds.skip(33);
+      if (type == 2) {
+         ds.skip(1);
+         skip_bytes(ds);
+      }
+   }
+
+   //signature variant: K1 / R1 compact signatures, or WA signature with authenticator data and client json
+   template<typename DS>
+   void skip_signature(DS& ds) {
+      uint32_t type = read_varuint(ds);
+      ds.skip(65);
+      if (type == 2) {
+         skip_bytes(ds);
+         skip_bytes(ds);
+      }
+   }
+
+   //bridgetypes::blockheader, keeping its timestamp and, when asked for, its previous block id and action_mroot
+   template<typename DS>
+   void read_blockheader(DS& ds, block_timestamp& timestamp, checksum256* previous = nullptr, checksum256* action_mroot = nullptr) {
+      ds >> timestamp;
+      ds.skip(8 + 2);   // producer, confirmed
+      if (previous) ds >> *previous;
+      else ds.skip(32);
+      ds.skip(32);      // transaction_mroot
+      if (action_mroot) ds >> *action_mroot;
+      else ds.skip(32);
+      ds.skip(4);       // schedule_version
+
+      bool has_new_producers;
+      ds >> has_new_producers;
+      if (has_new_producers) {
+         ds.skip(4); // version
+         uint32_t producers = read_varuint(ds);
+         for (uint32_t i = 0; i < producers; i++) {
+            ds.skip(8);
+            skip_public_key(ds);
+         }
+      }
+
+      uint32_t extensions = read_varuint(ds);
+      for (uint32_t i = 0; i < extensions; i++) {
+         ds.skip(2);
+         skip_bytes(ds);
+      }
+   }
+
+   //bridgetypes::sblockheader, keeping the same header fields as read_blockheader
+   template<typename DS>
+   void read_sblockheader(DS& ds, block_timestamp& timestamp, checksum256* previous = nullptr, checksum256* action_mroot = nullptr) {
+      read_blockheader(ds, timestamp, previous, action_mroot);
+
+      uint32_t signatures = read_varuint(ds);
+      for (uint32_t i = 0; i < signatures; i++) skip_signature(ds);
+
+      ds.skip(32);          // previous_bmroot
+      skip_vector(ds, 2);   // bmproofpath
+   }
+
+   //bridgetypes::heavyproof, header fields are those of the proven block
+   template<typename DS>
+   void read_heavyproof(DS& ds, checksum256& chain_id, block_timestamp& timestamp, checksum256* previous = nullptr, checksum256* action_mroot = nullptr) {
+      ds >> chain_id;
+      skip_vector(ds, 32);               // hashes
+
+      read_sblockheader(ds, timestamp, previous, action_mroot);  // blocktoprove.block
+      skip_vector(ds, 2);                // blocktoprove.active_nodes
+      ds.skip(8);                        // blocktoprove.node_count
+
+      block_timestamp ignored;
+      uint32_t bftproof = read_varuint(ds);
+      for (uint32_t i = 0; i < bftproof; i++) read_sblockheader(ds, ignored);
+   }
+
+   //bridgetypes::lightproof
+   template<typename DS>
+   void read_lightproof(DS& ds, checksum256& chain_id, block_timestamp& timestamp) {
+      ds >> chain_id;
+      read_blockheader(ds, timestamp);
+      ds.skip(32);           // root
+      skip_vector(ds, 32);   // bmproofpath
+   }
+
+   //bridgetypes::actionproof, keeping the action and the digest of its receipt
+   //the receipt is decoded and hashed in its canonical encoding as the bridge does, so re-encoding it (e.g. with padded
+   //varints) cannot produce another digest for the same receipt
+   template<typename DS>
+   void read_actionproof(DS& ds, action& act, checksum256& receipt_digest) {
+      ds >> act;
+      bridgetypes::actreceipt receipt;
+      ds >> receipt;
+      receipt_digest = proofcheck::receipt_digest(receipt);
+      skip_bytes(ds);         // returnvalue
+      skip_vector(ds, 32);    // amproofpath
+   }
+
+}
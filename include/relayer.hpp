@@ -0,0 +1,440 @@
+#pragma once
+
+#ifdef __wasm__
+#error "relayer.hpp is host side tooling and cannot be built into the contract"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include <eosio/transaction.hpp>
+
+#include <accumulator.hpp>
+#include <proofcheck.hpp>
+
+// Relayer submission pipeline: takes ready proofs for wraplock (`withdrawa` / `withdrawb` / `cancela` / `cancelb`),
+// groups them by proven block and proof type, packs them into transactions within CPU/NET budgets using a calibrated
+// cost model, then signs on worker threads while a submitter pushes the signed transactions as they become ready.
+// A transaction of several actions rejected by the chain is bisected, its halves submitted as transactions of their
+// own, so a single failing proof ends up alone and only it is dropped. Transactions of one action, and those failing on
+// signing or transport errors, are prepared, signed and pushed again up to `pipeline::max_attempts` times. The cpu
+// billed for accepted transactions calibrates the cost model for the next runs.
+//
+// The chain is reached through `relayer::endpoint`, `relayer::mock_endpoint` stands in for it in tests.
+
+namespace relayer {
+
+   using namespace eosio;
+
+   // a proof ready to be submitted to wraplock
+   struct ready_proof {
+      name                                                     action;      // withdrawa, withdrawb, cancela or cancelb
+      name                                                     prover;
+      std::variant<bridgetypes::heavyproof, bridgetypes::lightproof>     blockproof;
+      bridgetypes::actionproof                                      actionproof;
+      std::optional<accumulator::nonmembership_witness>             witness;          // once the block's epoch is archived
+      std::optional<accumulator::nonmembership_witness>             legacy_witness;   // once the legacy digests are archived
+
+      bool heavy() const { return std::holds_alternative<bridgetypes::heavyproof>(blockproof); }
+
+      uint32_t block_num() const {
+         return heavy() ? std::get<bridgetypes::heavyproof>(blockproof).blocktoprove.block.header.block_num()
+                        : std::get<bridgetypes::lightproof>(blockproof).header.block_num();
+      }
+
+      // action data, laid out as the wraplock action arguments, the witnesses are left out when neither is needed
+      std::vector<char> data() const {
+         std::vector<char> out = pack(prover);
+         std::vector<char> proof = std::visit([](const auto& p) { return pack(p); }, blockproof);
+         std::vector<char> act = pack(actionproof);
+         out.insert(out.end(), proof.begin(), proof.end());
+         out.insert(out.end(), act.begin(), act.end());
+         if (witness || legacy_witness) {
+            std::vector<char> witnesses = pack(std::make_tuple(witness, legacy_witness));
+            out.insert(out.end(), witnesses.begin(), witnesses.end());
+         }
+         return out;
+      }
+   };
+
+   // estimated cost of a wraplock action as a linear function of its serialized size
+   struct cost_model {
+      struct coefficients {
+         double   base_us;        // fixed cpu cost, including the inline bridge verification
+         double   per_byte_us;    // cpu cost per byte of action data
+      };
+
+      // measured cpu of a transaction holding `actions` actions of one proof type, `data_bytes` of action data in total
+      struct sample {
+         size_t   actions;
+         size_t   data_bytes;
+         double   cpu_us;
+      };
+
+      coefficients   heavy = { 2500, 0.35 };   // withdrawa / cancela: signature recovery over the bft proof
+      coefficients   light = { 450, 0.10 };    // withdrawb / cancelb
+      size_t         action_overhead_bytes = 64;        // account, name, authorization, length prefixes
+      size_t         transaction_overhead_bytes = 160;  // header, signature, packed transaction envelope
+      double         margin = 1.5;                      // headroom of the declared max_cpu_usage_ms over the estimate
+
+      double cpu_us(const bool is_heavy, const size_t data_size) const {
+         const auto& c = is_heavy ? heavy : light;
+         return c.base_us + c.per_byte_us * data_size;
+      }
+
+      size_t net_bytes(const size_t data_size) const { return data_size + action_overhead_bytes; }
+
+      // cpu limit declared by a transaction estimated at `cpu_us`, the chain bills at most 255 ms through this field
+      uint8_t max_cpu_usage_ms(const double cpu_us) const { return uint8_t(std::min(255.0, std::ceil(cpu_us * margin / 1000))); }
+
+      // least squares fit of the coefficients, cpu = base * actions + per byte * data bytes, from measured samples,
+      // e.g. the cpu billed for accepted transactions or single actions run on a local node
+      void calibrate(const bool is_heavy, const std::vector<sample>& samples) {
+         if (samples.size() < 2) return;
+         double saa = 0, sab = 0, sbb = 0, say = 0, sby = 0;
+         for (const auto& s : samples) {
+            double a = s.actions, b = s.data_bytes;
+            saa += a * a; sab += a * b; sbb += b * b; say += a * s.cpu_us; sby += b * s.cpu_us;
+         }
+         double determinant = saa * sbb - sab * sab;
+         if (std::abs(determinant) <= 1e-9 * saa * sbb) return;
+         auto& c = is_heavy ? heavy : light;
+         c.per_byte_us = std::max(0.0, (saa * sby - sab * say) / determinant);
+         c.base_us = std::max(0.0, (say - c.per_byte_us * sab) / saa);
+      }
+   };
+
+   // per transaction limits, keep below the chain's max_transaction_cpu_usage / max_transaction_net_usage
+   struct budget {
+      double   cpu_us = 30000;
+      size_t   net_bytes = 64 * 1024;
+   };
+
+   struct batch {
+      std::vector<action>     actions;
+      std::vector<size_t>     proofs;          // index of each action's proof among those packed
+      double                  cpu_us = 0;
+      size_t                  net_bytes = 0;
+      size_t                  heavy_actions = 0;
+      size_t                  data_bytes = 0;
+   };
+
+   // transaction of the proofs at `indices`, in that order, with its estimated cost
+   inline batch make_batch(const std::vector<ready_proof>& proofs, const std::vector<size_t>& indices, const name& contract, const permission_level& auth, const cost_model& costs) {
+      batch b;
+      b.net_bytes = costs.transaction_overhead_bytes;
+      for (auto i : indices) {
+         action a;
+         a.account = contract;
+         a.name = proofs[i].action;
+         a.authorization = { auth };
+         a.data = proofs[i].data();
+
+         b.cpu_us += costs.cpu_us(proofs[i].heavy(), a.data.size());
+         b.net_bytes += costs.net_bytes(a.data.size());
+         b.data_bytes += a.data.size();
+         b.heavy_actions += proofs[i].heavy();
+         b.actions.push_back(std::move(a));
+         b.proofs.push_back(i);
+      }
+      return b;
+   }
+
+   // groups proofs by proven block then proof type, and fills transactions greedily within the budget
+   // a single action above the budget gets a transaction of its own
+   inline std::vector<batch> pack_batches(const std::vector<ready_proof>& proofs, const name& contract, const permission_level& auth, const cost_model& costs, const budget& limits) {
+
+      std::vector<size_t> order(proofs.size());
+      for (size_t i = 0; i < order.size(); i++) order[i] = i;
+      std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b) {
+         if (proofs[a].block_num() != proofs[b].block_num()) return proofs[a].block_num() < proofs[b].block_num();
+         return proofs[a].heavy() > proofs[b].heavy();
+      });
+
+      std::vector<batch> batches;
+      std::vector<size_t> current;
+      double cpu_us = 0;
+      size_t net_bytes = costs.transaction_overhead_bytes;
+
+      for (auto i : order) {
+         size_t data_size = proofs[i].data().size();
+         double cpu = costs.cpu_us(proofs[i].heavy(), data_size);
+         size_t net = costs.net_bytes(data_size);
+
+         if (!current.empty() && (cpu_us + cpu > limits.cpu_us || net_bytes + net > limits.net_bytes)) {
+            batches.push_back(make_batch(proofs, current, contract, auth, costs));
+            current.clear();
+            cpu_us = 0;
+            net_bytes = costs.transaction_overhead_bytes;
+         }
+         current.push_back(i);
+         cpu_us += cpu;
+         net_bytes += net;
+      }
+      if (!current.empty()) batches.push_back(make_batch(proofs, current, contract, auth, costs));
+
+      return batches;
+   }
+
+   struct signed_trx {
+      transaction                trx;
+      std::vector<signature>     signatures;
+   };
+
+   // digest signed for a transaction, as computed by nodes
+   inline checksum256 signing_digest(const checksum256& chain_id, const transaction& trx) {
+      std::vector<char> buf;
+      auto id = chain_id.extract_as_byte_array();
+      buf.insert(buf.end(), id.begin(), id.end());
+      std::vector<char> packed = pack(trx);
+      buf.insert(buf.end(), packed.begin(), packed.end());
+      buf.resize(buf.size() + 32, 0); // no context free data
+      return proofcheck::hash(buf.data(), buf.size());
+   }
+
+   // outcome of a push, with the cpu billed when accepted
+   struct push_result {
+      bool           accepted = false;
+      uint32_t       cpu_usage_us = 0;
+      std::string    error;
+   };
+
+   class endpoint {
+      public:
+         virtual ~endpoint() = default;
+
+         virtual checksum256 chain_id() = 0;
+
+         // fills in the transaction header (tapos, expiration) for `actions`
+         virtual transaction prepare(std::vector<action> actions) = 0;
+
+         // pushes a signed transaction; must be thread safe, may throw on transport errors
+         virtual push_result push(const signed_trx& trx) = 0;
+   };
+
+   // local stand-in for a node, records what is pushed and lets `handler` decide the outcome (accepted by default)
+   class mock_endpoint : public endpoint {
+      public:
+         explicit mock_endpoint(const checksum256& chain_id, std::function<push_result(const signed_trx&)> handler = {})
+         : _chain_id(chain_id), _handler(std::move(handler)) {}
+
+         checksum256 chain_id() override { return _chain_id; }
+
+         transaction prepare(std::vector<action> actions) override {
+            transaction trx(time_point_sec(3600));
+            trx.actions = std::move(actions);
+            return trx;
+         }
+
+         push_result push(const signed_trx& trx) override {
+            push_result result = _handler ? _handler(trx) : push_result{ true, 0, {} };
+            std::lock_guard<std::mutex> g(_lock);
+            (result.accepted ? _pushed : _rejected).push_back(trx);
+            return result;
+         }
+
+         std::vector<signed_trx> pushed() { std::lock_guard<std::mutex> g(_lock); return _pushed; }
+         std::vector<signed_trx> rejected() { std::lock_guard<std::mutex> g(_lock); return _rejected; }
+
+      private:
+         checksum256                                        _chain_id;
+         std::function<push_result(const signed_trx&)>      _handler;
+         std::mutex                                         _lock;
+         std::vector<signed_trx>                            _pushed;
+         std::vector<signed_trx>                            _rejected;
+   };
+
+   // outcome of one batch over all its attempts
+   struct batch_report {
+      size_t                 actions = 0;
+      size_t                 attempts = 0;
+      bool                   accepted = false;
+      bool                   split = false;   // rejected by the chain, its actions went on in two halves reported later
+      std::string            error;           // of the last failed attempt, signing or push
+      std::vector<size_t>    proofs;          // index of each action's proof among those given to `run`
+   };
+
+   struct report {
+      size_t                       transactions = 0;   // batches submitted, including the halves of split ones
+      size_t                       accepted = 0;
+      size_t                       actions = 0;
+      std::vector<batch_report>    batches;     // in packing order, then halves in the order they were split off
+      std::vector<size_t>          failed;      // proofs dropped as their batch ran out of attempts, ascending
+   };
+
+   class pipeline {
+      public:
+         using signer = std::function<std::vector<signature>(const checksum256& digest)>;
+
+         size_t   max_attempts = 3;        // rounds of signing and pushing a batch before it is reported as failed
+         size_t   max_samples = 256;       // cpu samples kept per proof type for calibration
+
+         pipeline(endpoint& chain, signer sign, const name& contract, const permission_level& auth, cost_model costs = {}, budget limits = {}, size_t signing_threads = 2)
+         : _chain(chain), _sign(std::move(sign)), _contract(contract), _auth(auth), _costs(costs), _limits(limits), _signing_threads(std::max<size_t>(signing_threads, 1)) {}
+
+         // cost model in use, calibrated from the cpu billed for the transactions accepted so far
+         const cost_model& costs() const { return _costs; }
+
+         // packs, signs and pushes `proofs`, returning once every batch is accepted or out of attempts
+         // signer and endpoint exceptions fail the attempt, they are reported rather than propagated
+         report run(const std::vector<ready_proof>& proofs) {
+
+            std::vector<batch> batches = pack_batches(proofs, _contract, _auth, _costs, _limits);
+            checksum256 chain_id = _chain.chain_id();
+
+            report r;
+            r.actions = proofs.size();
+            auto add_report = [&](const batch& b) {
+               batch_report br;
+               br.actions = b.actions.size();
+               br.proofs = b.proofs;
+               r.batches.push_back(std::move(br));
+            };
+            for (const auto& b : batches) add_report(b);
+
+            // every round prepares, signs and pushes the batches not accepted yet; a batch the chain rejected is
+            // replaced by its two halves, so the rounds go on until every proof is accepted or alone out of attempts
+            std::vector<size_t> pending(batches.size());
+            for (size_t i = 0; i < pending.size(); i++) pending[i] = i;
+
+            while (!pending.empty()) {
+               for (auto i : pending) r.batches[i].attempts++;
+               std::vector<bool> rejected_by_chain(batches.size(), false);
+               run_round(batches, pending, chain_id, r, rejected_by_chain);
+
+               std::vector<size_t> next;
+               for (auto i : pending) {
+                  if (r.batches[i].accepted) continue;
+                  if (rejected_by_chain[i] && batches[i].actions.size() > 1) {
+                     r.batches[i].split = true;
+                     auto middle = batches[i].proofs.begin() + batches[i].proofs.size() / 2;
+                     for (auto half : { std::vector<size_t>(batches[i].proofs.begin(), middle), std::vector<size_t>(middle, batches[i].proofs.end()) }) {
+                        batches.push_back(make_batch(proofs, half, _contract, _auth, _costs));
+                        add_report(batches.back());
+                        next.push_back(batches.size() - 1);
+                     }
+                  }
+                  else if (r.batches[i].attempts < max_attempts) next.push_back(i);
+                  else r.failed.insert(r.failed.end(), batches[i].proofs.begin(), batches[i].proofs.end());
+               }
+               pending = std::move(next);
+            }
+
+            r.transactions = r.batches.size();
+            for (const auto& b : r.batches) r.accepted += b.accepted;
+            std::sort(r.failed.begin(), r.failed.end());
+
+            _costs.calibrate(true, _heavy_samples);
+            _costs.calibrate(false, _light_samples);
+
+            return r;
+         }
+
+      private:
+         // `rejected_by_chain` marks the batches pushed and refused by the chain, as opposed to failed on the way
+         void run_round(const std::vector<batch>& batches, const std::vector<size_t>& pending, const checksum256& chain_id, report& r, std::vector<bool>& rejected_by_chain) {
+
+            std::mutex lock;
+            std::condition_variable ready;
+            std::deque<std::pair<size_t, signed_trx>> signed_queue;
+            size_t signers_done = 0;
+
+            auto fail = [&](const size_t i, std::string error) {
+               std::lock_guard<std::mutex> g(lock);
+               r.batches[i].error = std::move(error);
+            };
+
+            // signing stage
+            std::atomic<size_t> next{0};
+            auto sign_work = [&]() {
+               for (size_t k = next++; k < pending.size(); k = next++) {
+                  size_t i = pending[k];
+                  try {
+                     signed_trx s;
+                     s.trx = _chain.prepare(batches[i].actions);
+                     s.trx.max_cpu_usage_ms = _costs.max_cpu_usage_ms(batches[i].cpu_us);
+                     s.signatures = _sign(signing_digest(chain_id, s.trx));
+
+                     std::lock_guard<std::mutex> g(lock);
+                     signed_queue.emplace_back(i, std::move(s));
+                     ready.notify_one();
+                  }
+                  catch (const std::exception& e) {
+                     fail(i, std::string("signing failed: ") + e.what());
+                  }
+               }
+               std::lock_guard<std::mutex> g(lock);
+               signers_done++;
+               ready.notify_one();
+            };
+
+            // submission stage, pushing as soon as a transaction is signed
+            std::thread submitter([&]() {
+               while (true) {
+                  std::unique_lock<std::mutex> g(lock);
+                  ready.wait(g, [&]() { return !signed_queue.empty() || signers_done == _signing_threads; });
+                  if (signed_queue.empty()) return;
+                  auto [i, s] = std::move(signed_queue.front());
+                  signed_queue.pop_front();
+                  g.unlock();
+
+                  push_result result;
+                  bool pushed = false;
+                  try {
+                     result = _chain.push(s);
+                     pushed = true;
+                  }
+                  catch (const std::exception& e) {
+                     result.error = std::string("push failed: ") + e.what();
+                  }
+
+                  if (!result.accepted) {
+                     fail(i, result.error.empty() ? "rejected" : result.error);
+                     rejected_by_chain[i] = pushed;   // only written here, read once the round is over
+                     continue;
+                  }
+
+                  g.lock();
+                  r.batches[i].accepted = true;
+                  r.batches[i].error.clear();
+                  g.unlock();
+                  if (result.cpu_usage_us > 0) record_sample(batches[i], result.cpu_usage_us);
+               }
+            });
+
+            std::vector<std::thread> signers;
+            for (size_t t = 0; t < _signing_threads; t++) signers.emplace_back(sign_work);
+            for (auto& t : signers) t.join();
+            submitter.join();
+         }
+
+         // only batches of a single proof type tell the coefficients of that type apart, called from the submitter alone
+         void record_sample(const batch& b, const uint32_t cpu_usage_us) {
+            if (b.heavy_actions != 0 && b.heavy_actions != b.actions.size()) return;
+            auto& samples = b.heavy_actions ? _heavy_samples : _light_samples;
+            if (samples.size() == max_samples) samples.erase(samples.begin());
+            samples.push_back({ b.actions.size(), b.data_bytes, double(cpu_usage_us) });
+         }
+
+         endpoint&                          _chain;
+         signer                             _sign;
+         name                               _contract;
+         permission_level                   _auth;
+         cost_model                         _costs;
+         budget                             _limits;
+         size_t                             _signing_threads;
+         std::vector<cost_model::sample>    _heavy_samples;
+         std::vector<cost_model::sample>    _light_samples;
+   };
+
+}
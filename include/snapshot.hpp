@@ -0,0 +1,250 @@
+#pragma once
+
+#ifdef __wasm__
+#error "snapshot.hpp is host side tooling and cannot be built into the contract"
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <eosio/action.hpp>
+#include <eosio/eosio.hpp>
+
+// Streaming snapshots of the wraplock tables.
+//
+//    file_header                        magic, format version, contract account
+//    chunk_header, rows                 repeated: table, scope, row count, byte size, then the rows back to back
+//    chunk_header with an empty table   end of snapshot
+//
+// Rows are serialized exactly as stored by the contract, so rows fetched in binary form (`get_table_rows` with
+// `"json": false`) are copied through unchanged, and each chunk is the payload of one `importrows` action. Headers
+// have a fixed size, readers can skip chunks without decoding them.
+//
+// The `global` and `legacyarc` tables are single rows in scope of the contract, the other tables use their contract
+// scopes (token contract for `reserves` / `resdeltas`, epoch or the contract for `processed`). Snapshots of a running
+// contract are exported with snapshotexport.hpp.
+
+namespace snapshot {
+
+   using namespace eosio;
+
+   inline constexpr uint32_t MAGIC = 0x70616e73;   // "snap"
+   inline constexpr uint16_t VERSION = 1;
+
+   struct file_header {
+      uint32_t    magic = MAGIC;
+      uint16_t    version = VERSION;
+      name        contract;
+
+      static constexpr size_t size = 4 + 2 + 8;
+
+      EOSLIB_SERIALIZE( file_header, (magic)(version)(contract) )
+   };
+
+   struct chunk_header {
+      name        table;
+      uint64_t    scope = 0;
+      uint32_t    row_count = 0;
+      uint32_t    byte_size = 0;
+
+      static constexpr size_t size = 8 + 8 + 4 + 4;
+
+      EOSLIB_SERIALIZE( chunk_header, (table)(scope)(row_count)(byte_size) )
+   };
+
+   // Writes a snapshot through a memory mapping grown as rows are added. Consecutive rows of the same table and scope
+   // are grouped in chunks of at most `max_chunk_rows` rows and `max_chunk_bytes` bytes, sized for one transaction.
+   class writer {
+      public:
+         writer(const char* path, const name& contract, const uint32_t max_chunk_rows = 500, const uint32_t max_chunk_bytes = 128 * 1024)
+         : _max_chunk_rows(std::max<uint32_t>(max_chunk_rows, 1)), _max_chunk_bytes(max_chunk_bytes) {
+            _fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+            check(_fd >= 0, "cannot create snapshot file");
+
+            file_header h;
+            h.contract = contract;
+            reserve(file_header::size);
+            datastream<char*> ds(_map + _size, file_header::size);
+            ds << h;
+            _size += file_header::size;
+         }
+
+         writer(const writer&) = delete;
+         writer& operator=(const writer&) = delete;
+
+         // a writer destroyed before `close` (e.g. while an export throws) must not throw: it clears the magic so readers
+         // reject the incomplete file, and releases it
+         ~writer() {
+            if (_fd < 0) return;
+            if (_map) {
+               memset(_map, 0, sizeof(MAGIC));
+               ::munmap(_map, _capacity);
+            }
+            ::close(_fd);
+         }
+
+         void row(const name& table, const uint64_t scope, const char* data, const size_t size) {
+            check(table != name(), "table name required");
+            if (!_chunk || _chunk->table != table || _chunk->scope != scope || _chunk->row_count == _max_chunk_rows ||
+                (_chunk->row_count > 0 && _chunk->byte_size + size > _max_chunk_bytes)) {
+               finish_chunk();
+               begin_chunk(table, scope);
+            }
+            reserve(size);
+            memcpy(_map + _size, data, size);
+            _size += size;
+            _chunk->row_count++;
+            _chunk->byte_size += size;
+         }
+
+         template<typename T>
+         void row(const name& table, const uint64_t scope, const T& value) {
+            std::vector<char> bytes = pack(value);
+            row(table, scope, bytes.data(), bytes.size());
+         }
+
+         // writes the end marker and trims the file, the snapshot is complete once closed
+         void close() {
+            if (_fd < 0) return;
+            finish_chunk();
+            begin_chunk(name(), 0);
+            finish_chunk();
+
+            ::munmap(_map, _capacity);
+            _map = nullptr;
+            bool trimmed = ::ftruncate(_fd, _size) == 0;
+            ::close(_fd);
+            _fd = -1;
+            check(trimmed, "cannot trim snapshot file");
+         }
+
+      private:
+         void reserve(const size_t bytes) {
+            if (_size + bytes <= _capacity) return;
+            size_t capacity = std::max({ _capacity * 2, _size + bytes, size_t(1) << 20 });
+            if (_map) ::munmap(_map, _capacity);
+            _map = nullptr;
+            check(::ftruncate(_fd, capacity) == 0, "cannot grow snapshot file");
+            void* m = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+            check(m != MAP_FAILED, "cannot map snapshot file");
+            _map = static_cast<char*>(m);
+            _capacity = capacity;
+         }
+
+         void begin_chunk(const name& table, const uint64_t scope) {
+            reserve(chunk_header::size);
+            _chunk_offset = _size;
+            _size += chunk_header::size;
+            _chunk = chunk_header{ table, scope, 0, 0 };
+         }
+
+         // the header is written once the chunk's rows are known
+         void finish_chunk() {
+            if (!_chunk) return;
+            datastream<char*> ds(_map + _chunk_offset, chunk_header::size);
+            ds << *_chunk;
+            _chunk.reset();
+         }
+
+         int                              _fd = -1;
+         char*                            _map = nullptr;
+         size_t                           _capacity = 0;
+         size_t                           _size = 0;
+         uint32_t                         _max_chunk_rows;
+         uint32_t                         _max_chunk_bytes;
+         std::optional<chunk_header>      _chunk;
+         size_t                           _chunk_offset = 0;
+   };
+
+   // Reads a snapshot from a read only memory mapping, chunk by chunk, without copying the rows.
+   class reader {
+      public:
+         struct chunk {
+            chunk_header   header;
+            const char*    rows;   // header.byte_size bytes, valid while the reader lives
+         };
+
+         explicit reader(const char* path) {
+            _fd = ::open(path, O_RDONLY);
+            check(_fd >= 0, "cannot open snapshot file");
+            struct stat st;
+            check(::fstat(_fd, &st) == 0, "cannot read snapshot file size");
+            _size = st.st_size;
+            check(_size >= file_header::size, "truncated snapshot");
+
+            void* m = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+            check(m != MAP_FAILED, "cannot map snapshot file");
+            _map = static_cast<const char*>(m);
+            ::madvise(m, _size, MADV_SEQUENTIAL);
+
+            datastream<const char*> ds(_map, file_header::size);
+            ds >> _header;
+            check(_header.magic == MAGIC, "not a wraplock snapshot");
+            check(_header.version == VERSION, "unsupported snapshot version");
+            _pos = file_header::size;
+         }
+
+         reader(const reader&) = delete;
+         reader& operator=(const reader&) = delete;
+
+         ~reader() {
+            if (_map) ::munmap(const_cast<char*>(_map), _size);
+            if (_fd >= 0) ::close(_fd);
+         }
+
+         const file_header& header() const { return _header; }
+
+         // next chunk, empty once the end marker is reached
+         std::optional<chunk> next() {
+            check(_pos + chunk_header::size <= _size, "truncated snapshot");
+            chunk c;
+            datastream<const char*> ds(_map + _pos, chunk_header::size);
+            ds >> c.header;
+            _pos += chunk_header::size;
+            if (c.header.table == name()) return std::nullopt;
+
+            check(_pos + c.header.byte_size <= _size, "truncated snapshot");
+            c.rows = _map + _pos;
+            _pos += c.header.byte_size;
+            return c;
+         }
+
+         // calls `f` with each row of `c` unpacked as `T`
+         template<typename T, typename F>
+         static void for_each_row(const chunk& c, F&& f) {
+            datastream<const char*> ds(c.rows, c.header.byte_size);
+            for (uint32_t i = 0; i < c.header.row_count; i++) {
+               T row;
+               ds >> row;
+               f(row);
+            }
+            check(ds.remaining() == 0, "chunk size does not match its rows");
+         }
+
+      private:
+         int               _fd = -1;
+         const char*       _map = nullptr;
+         size_t            _size = 0;
+         size_t            _pos = 0;
+         file_header       _header;
+   };
+
+   // `importrows` action loading chunk `c` into `contract`
+   inline action import_action(const name& contract, const reader::chunk& c) {
+      action act;
+      act.account = contract;
+      act.name = "importrows"_n;
+      act.authorization = { permission_level{ contract, "active"_n } };
+      act.data = pack(std::make_tuple(c.header.table, c.header.scope, unsigned_int(c.header.byte_size)));
+      act.data.insert(act.data.end(), c.rows, c.rows + c.header.byte_size);
+      return act;
+   }
+
+}
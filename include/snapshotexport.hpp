@@ -0,0 +1,343 @@
+#pragma once
+
+#ifdef __wasm__
+#error "snapshotexport.hpp is host side tooling and cannot be built into the contract"
+#endif
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <snapshot.hpp>
+
+// Exports the wraplock tables of a running chain into a snapshot (see snapshot.hpp) through the chain API of a node:
+// `get_table_by_scope` lists the scopes of each table, then `get_table_rows` with `"json": false` pages through the
+// rows of each scope in binary form, the form snapshots store them in.
+//
+// Requests go through `snapshot::rpc`, `snapshot::http_rpc` posts them to a node over plain HTTP. Responses are read
+// with a minimal JSON parser, numbers are kept as written.
+
+namespace snapshot {
+
+   // posts `body` to the chain API `path` (e.g. "/v1/chain/get_table_rows") and returns the response body
+   using rpc = std::function<std::string(const std::string& path, const std::string& body)>;
+
+   namespace json {
+
+      struct value {
+         enum kind_t { null, boolean, number, string, array, object };
+
+         kind_t                                        kind = null;
+         bool                                          flag = false;   // boolean
+         std::string                                   text;           // string contents, or a number as written
+         std::vector<value>                            items;          // array
+         std::vector<std::pair<std::string, value>>    members;        // object, in document order
+
+         // member `key` of an object, null if absent
+         const value& operator[](const std::string& key) const {
+            static const value missing;
+            for (const auto& [k, v] : members) if (k == key) return v;
+            return missing;
+         }
+      };
+
+      class parser {
+         public:
+            explicit parser(const std::string& text) : _s(text) {}
+
+            value parse() {
+               value v = parse_value();
+               skip_space();
+               check(_p == _s.size(), "trailing characters after json value");
+               return v;
+            }
+
+         private:
+            void skip_space() { while (_p < _s.size() && (_s[_p] == ' ' || _s[_p] == '\t' || _s[_p] == '\n' || _s[_p] == '\r')) _p++; }
+
+            char peek() {
+               skip_space();
+               check(_p < _s.size(), "unexpected end of json");
+               return _s[_p];
+            }
+
+            void expect(const char c) {
+               check(peek() == c, "malformed json");
+               _p++;
+            }
+
+            bool literal(const char* word) {
+               size_t n = strlen(word);
+               if (_s.compare(_p, n, word) != 0) return false;
+               _p += n;
+               return true;
+            }
+
+            value parse_value() {
+               value v;
+               char c = peek();
+               if (c == '{') {
+                  v.kind = value::object;
+                  _p++;
+                  if (peek() == '}') { _p++; return v; }
+                  while (true) {
+                     peek();
+                     std::string key = parse_string();
+                     expect(':');
+                     v.members.emplace_back(std::move(key), parse_value());
+                     if (peek() != ',') break;
+                     _p++;
+                  }
+                  expect('}');
+               }
+               else if (c == '[') {
+                  v.kind = value::array;
+                  _p++;
+                  if (peek() == ']') { _p++; return v; }
+                  while (true) {
+                     v.items.push_back(parse_value());
+                     if (peek() != ',') break;
+                     _p++;
+                  }
+                  expect(']');
+               }
+               else if (c == '"') {
+                  v.kind = value::string;
+                  v.text = parse_string();
+               }
+               else if (literal("true")) {
+                  v.kind = value::boolean;
+                  v.flag = true;
+               }
+               else if (literal("false")) {
+                  v.kind = value::boolean;
+               }
+               else if (literal("null")) {
+                  v.kind = value::null;
+               }
+               else {
+                  size_t start = _p;
+                  while (_p < _s.size() && strchr("+-0123456789.eE", _s[_p])) _p++;
+                  check(_p > start, "malformed json");
+                  v.kind = value::number;
+                  v.text = _s.substr(start, _p - start);
+               }
+               return v;
+            }
+
+            std::string parse_string() {
+               check(_s[_p++] == '"', "malformed json string");
+               std::string out;
+               while (true) {
+                  check(_p < _s.size(), "unterminated json string");
+                  char c = _s[_p++];
+                  if (c == '"') return out;
+                  if (c != '\\') { out += c; continue; }
+
+                  check(_p < _s.size(), "unterminated json string");
+                  char e = _s[_p++];
+                  switch (e) {
+                     case 'b': out += '\b'; break;
+                     case 'f': out += '\f'; break;
+                     case 'n': out += '\n'; break;
+                     case 'r': out += '\r'; break;
+                     case 't': out += '\t'; break;
+                     case 'u': {
+                        check(_p + 4 <= _s.size(), "malformed json escape");
+                        uint32_t cp = std::stoul(_s.substr(_p, 4), nullptr, 16);
+                        _p += 4;
+                        // basic multilingual plane only, enough for chain API responses
+                        if (cp < 0x80) out += char(cp);
+                        else if (cp < 0x800) { out += char(0xc0 | (cp >> 6)); out += char(0x80 | (cp & 0x3f)); }
+                        else { out += char(0xe0 | (cp >> 12)); out += char(0x80 | ((cp >> 6) & 0x3f)); out += char(0x80 | (cp & 0x3f)); }
+                        break;
+                     }
+                     default: out += e;   // \" \\ \/
+                  }
+               }
+            }
+
+            const std::string&    _s;
+            size_t                _p = 0;
+      };
+
+      inline value parse(const std::string& text) { return parser(text).parse(); }
+
+      // `s` as a json string literal
+      inline std::string quote(const std::string& s) {
+         std::string out = "\"";
+         for (char c : s) {
+            if (c == '"' || c == '\\') { out += '\\'; out += c; }
+            else if (uint8_t(c) < 0x20) {
+               char buf[8];
+               snprintf(buf, sizeof(buf), "\\u%04x", unsigned(c));
+               out += buf;
+            }
+            else out += c;
+         }
+         return out + "\"";
+      }
+
+   }
+
+   // Posts chain API requests to a node over plain HTTP/1.1, one connection per request.
+   class http_rpc {
+      public:
+         http_rpc(std::string host, std::string port = "8888") : _host(std::move(host)), _port(std::move(port)) {}
+
+         std::string operator()(const std::string& path, const std::string& body) const {
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            addrinfo* addresses = nullptr;
+            check(::getaddrinfo(_host.c_str(), _port.c_str(), &hints, &addresses) == 0, "cannot resolve node address");
+
+            int fd = -1;
+            for (addrinfo* a = addresses; a && fd < 0; a = a->ai_next) {
+               fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+               if (fd >= 0 && ::connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+                  ::close(fd);
+                  fd = -1;
+               }
+            }
+            ::freeaddrinfo(addresses);
+            check(fd >= 0, "cannot connect to node");
+
+            std::string request = "POST " + path + " HTTP/1.1\r\nHost: " + _host + "\r\nContent-Type: application/json\r\nContent-Length: " +
+                                  std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+            std::string response;
+            bool sent = true;
+            for (size_t off = 0; off < request.size() && sent; ) {
+               ssize_t n = ::send(fd, request.data() + off, request.size() - off, 0);
+               sent = n > 0;
+               off += sent ? n : 0;
+            }
+            char buf[16384];
+            for (ssize_t n; sent && (n = ::recv(fd, buf, sizeof(buf), 0)) > 0; ) response.append(buf, n);
+            ::close(fd);
+            check(sent, "cannot send request to node");
+
+            return body_of(response);
+         }
+
+      private:
+         static std::string body_of(const std::string& response) {
+            size_t end = response.find("\r\n\r\n");
+            check(response.compare(0, 5, "HTTP/") == 0 && end != std::string::npos, "malformed http response");
+            std::string headers = response.substr(0, end);
+            std::string body = response.substr(end + 4);
+
+            size_t status_at = headers.find(' ');
+            int status = status_at == std::string::npos ? 0 : std::atoi(headers.c_str() + status_at + 1);
+            check(status == 200, "node returned http status " + std::to_string(status) + ": " + body.substr(0, 512));
+
+            std::string lower = headers;
+            for (auto& c : lower) c = std::tolower(uint8_t(c));
+            if (lower.find("transfer-encoding: chunked") == std::string::npos) return body;
+
+            std::string decoded;
+            for (size_t p = 0; ; ) {
+               size_t line_end = body.find("\r\n", p);
+               check(line_end != std::string::npos, "malformed chunked response");
+               size_t size = std::stoul(body.substr(p, line_end - p), nullptr, 16);
+               if (size == 0) return decoded;
+               check(line_end + 2 + size <= body.size(), "truncated chunked response");
+               decoded.append(body, line_end + 2, size);
+               p = line_end + 2 + size + 2;
+            }
+         }
+
+         std::string    _host;
+         std::string    _port;
+   };
+
+   // tables of the wraplock contract, in the order `importrows` loads them
+   inline const std::vector<name>& wraplock_tables() {
+      static const std::vector<name> tables = { "global"_n, "contractmap"_n, "reserves"_n, "resdeltas"_n, "processed"_n, "archives"_n, "legacyarc"_n, "locks"_n };
+      return tables;
+   }
+
+   // Pages through the tables of `contract` and appends their rows to a snapshot writer.
+   class exporter {
+      public:
+         exporter(rpc call, const name& contract, const uint32_t page_rows = 500)
+         : _call(std::move(call)), _contract(contract), _page_rows(std::max<uint32_t>(page_rows, 1)) {}
+
+         // scopes holding rows of `table`
+         std::vector<uint64_t> scopes(const name& table) const {
+            std::vector<uint64_t> out;
+            std::string lower_bound;
+            do {
+               json::value r = request("/v1/chain/get_table_by_scope", "{\"code\":" + json::quote(_contract.to_string()) + ",\"table\":" + json::quote(table.to_string()) +
+                                       ",\"lower_bound\":" + json::quote(lower_bound) + ",\"limit\":" + std::to_string(_page_rows) + "}");
+               for (const auto& row : r["rows"].items) {
+                  if (row["table"].text == table.to_string()) out.push_back(name(row["scope"].text).value);
+               }
+               lower_bound = r["more"].text;
+            } while (!lower_bound.empty());
+            return out;
+         }
+
+         // appends the rows of `table` in `scope` to `out`, returns how many
+         uint32_t rows(const name& table, const uint64_t scope, writer& out) const {
+            uint32_t count = 0;
+            std::string lower_bound;
+            bool more = true;
+            while (more) {
+               json::value r = request("/v1/chain/get_table_rows", "{\"code\":" + json::quote(_contract.to_string()) + ",\"scope\":" + json::quote(name(scope).to_string()) +
+                                       ",\"table\":" + json::quote(table.to_string()) + ",\"json\":false,\"lower_bound\":" + json::quote(lower_bound) +
+                                       ",\"limit\":" + std::to_string(_page_rows) + "}");
+               for (const auto& row : r["rows"].items) {
+                  check(row.kind == json::value::string, "rows must be requested in binary form");
+                  std::vector<char> bytes = from_hex(row.text);
+                  out.row(table, scope, bytes.data(), bytes.size());
+                  count++;
+               }
+               more = r["more"].kind == json::value::boolean && r["more"].flag;
+               check(!more || !r["next_key"].text.empty(), "paged response without next_key");
+               lower_bound = r["next_key"].text;
+            }
+            return count;
+         }
+
+         // every row of `tables`, scope by scope, returns how many
+         uint64_t run(writer& out, const std::vector<name>& tables = wraplock_tables()) const {
+            uint64_t count = 0;
+            for (const auto& table : tables) {
+               for (auto scope : scopes(table)) count += rows(table, scope, out);
+            }
+            return count;
+         }
+
+      private:
+         json::value request(const std::string& path, const std::string& body) const { return json::parse(_call(path, body)); }
+
+         static std::vector<char> from_hex(const std::string& hex) {
+            check(hex.size() % 2 == 0, "malformed hex row");
+            auto nibble = [](const char c) -> int {
+               if (c >= '0' && c <= '9') return c - '0';
+               if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+               if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+               check(false, "malformed hex row");
+               return 0;
+            };
+            std::vector<char> out(hex.size() / 2);
+            for (size_t i = 0; i < out.size(); i++) out[i] = char(nibble(hex[2 * i]) << 4 | nibble(hex[2 * i + 1]));
+            return out;
+         }
+
+         rpc         _call;
+         name        _contract;
+         uint32_t    _page_rows;
+   };
+
+}
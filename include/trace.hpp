@@ -0,0 +1,63 @@
+#pragma once
+
+#include <eosio/print.hpp>
+
+// Compile-time leveled tracing, replacing unconditional `print` calls.
+//
+//    WRAPLOCK_TRACE(level, category, "event", "key", value, ...);
+//
+// emits one console line `trace <level> <category> <event> key=value ...` when `level` is enabled by
+// WRAPLOCK_TRACE_LEVEL (0 off, 1 error, 2 info, 3 debug) and `category` by the WRAPLOCK_TRACE_CATEGORIES bitmask.
+// Disabled traces generate no code, their arguments are not even evaluated. Release builds use level 0.
+
+#ifndef WRAPLOCK_TRACE_LEVEL
+#define WRAPLOCK_TRACE_LEVEL 0
+#endif
+
+#ifndef WRAPLOCK_TRACE_CATEGORIES
+#define WRAPLOCK_TRACE_CATEGORIES 0xFFFFFFFF
+#endif
+
+namespace trace {
+
+   enum level : int {
+      error = 1,
+      info  = 2,
+      debug = 3
+   };
+
+   enum category : uint32_t {
+      deposit  = 1 << 0,
+      withdraw = 1 << 1,
+      cancel   = 1 << 2,
+      archive  = 1 << 3,
+      admin    = 1 << 4
+   };
+
+   constexpr bool enabled(const level l, const category c) {
+      return l <= WRAPLOCK_TRACE_LEVEL && (uint32_t(c) & uint32_t(WRAPLOCK_TRACE_CATEGORIES)) != 0;
+   }
+
+   inline void fields() {}
+
+   template<typename V, typename... Rest>
+   void fields(const char* key, const V& value, const Rest&... rest) {
+      eosio::print(" ", key, "=", value);
+      fields(rest...);
+   }
+
+   template<typename... Fields>
+   void record(const char* level, const char* category, const char* event, const Fields&... f) {
+      eosio::print("trace ", level, " ", category, " ", event);
+      fields(f...);
+      eosio::print("\n");
+   }
+
+}
+
+#if WRAPLOCK_TRACE_LEVEL > 0
+#define WRAPLOCK_TRACE(level, category, ...) \
+   do { if constexpr (::trace::enabled(::trace::level, ::trace::category)) ::trace::record(#level, #category, __VA_ARGS__); } while (0)
+#else
+#define WRAPLOCK_TRACE(level, category, ...) do {} while (0)
+#endif
@@ -3,11 +3,28 @@
 #include <eosio/asset.hpp>
 #include <eosio/eosio.hpp>
 #include <eosio/singleton.hpp>
+#include <eosio/system.hpp>
 
 #include <string>
 
-#include <bridge.hpp>
+#include <bridge_types.hpp>
 #include <eosio.token.hpp>
+#include <proofstream.hpp>
+#include <proofcheck.hpp>
+#include <accumulator.hpp>
+
+// proving schemes compiled into the contract, set through the WRAPLOCK_HEAVY_PROOFS / WRAPLOCK_LIGHT_PROOFS cmake options
+#ifndef WRAPLOCK_HEAVY_PROOFS
+#define WRAPLOCK_HEAVY_PROOFS 1
+#endif
+
+#ifndef WRAPLOCK_LIGHT_PROOFS
+#define WRAPLOCK_LIGHT_PROOFS 1
+#endif
+
+#if !WRAPLOCK_HEAVY_PROOFS && !WRAPLOCK_LIGHT_PROOFS
+#error "at least one of WRAPLOCK_HEAVY_PROOFS and WRAPLOCK_LIGHT_PROOFS must be enabled"
+#endif
 
 namespace eosiosystem {
    class system_contract;
@@ -20,44 +37,13 @@ namespace eosio {
    class [[eosio::contract("wraplock")]] wraplock : public contract {
       private:
 
-         // for bridge communication
-         TABLE lpstruct {
-
-            uint64_t id;
-
-            bridge::lightproof lp;
-
-            uint64_t primary_key()const { return id; }
-
-            EOSLIB_SERIALIZE( lpstruct, (id)(lp) )
-
-         } _light_proof_obj;
-
-         TABLE hpstruct {
-
-            uint64_t id;
-
-            bridge::heavyproof hp;
-
-            uint64_t primary_key()const { return id; }
-
-            EOSLIB_SERIALIZE( hpstruct, (id)(hp) )
-
-         } _heavy_proof_obj;
-
-         using lptable = eosio::singleton<"lightproof"_n, lpstruct>;
-         using hptable = eosio::singleton<"heavyproof"_n, hpstruct>;
-
-         lptable _light_proof;
-         hptable _heavy_proof;
-
-
          // structure used for globals - see `init` action for documentation
          struct [[eosio::table]] global {
             checksum256   chain_id;
             name          bridge_contract;
             checksum256   paired_chain_id;
             bool          enabled;
+            binary_extension<bool>       direct_refund;    // cancels release the tokens from the reserve instead of emitting an xfer
          } globalrow;
 
          // structure used for reserve account balances, scoped by token contract
@@ -76,10 +62,20 @@ namespace eosio {
             uint64_t by_paired_wraptoken_contract()const { return paired_wraptoken_contract.value; }
          };
 
+         // structure used for deposits not yet compacted into `reserves`, scoped by token contract
+         // sharded by account so that deposits and withdrawals of unrelated accounts write different rows
+         struct [[eosio::table]] reserve_delta {
+            uint64_t id;      // shard in the top byte, symbol code below
+            asset    delta;   // never negative, withdrawals take from the shards then from `reserves`
+
+            uint64_t primary_key()const { return id; }
+         };
+
          // structure used for retaining action receipt digests of accepted proven actions, to prevent replay attacks
+         // scoped by the epoch of the proven block (rows accepted before epochs were introduced are scoped by this contract)
          struct [[eosio::table]] processed {
 
-           uint64_t                        id;
+           uint64_t                        id;   // leading bytes of the digest, so unrelated inserts touch different rows
            checksum256                     receipt_digest;
 
            uint64_t primary_key()const { return id; }
@@ -87,11 +83,66 @@ namespace eosio {
 
          };
 
-         void sub_reserve(const extended_asset& value );
-         void add_reserve(const extended_asset& value );
-         void add_or_assert(const bridge::actionproof& actionproof, const name& payer);
-         void _withdraw(const name& prover, const bridge::actionproof actionproof);
-         void _cancel(const name& prover, const bridge::actionproof actionproof);
+         // structure used for the digests of an epoch folded out of `processed` by `archive`
+         struct [[eosio::table]] archived_epoch {
+            uint64_t             epoch;
+            accumulator::mmr     acc;         // sorted digests archived so far
+            checksum256          last_leaf;   // greatest digest archived
+
+            uint64_t primary_key()const { return epoch; }
+         };
+
+         // structure used for the digests folded out of the contract scope of `processed` by `archlegacy`, which predate epochs
+         struct [[eosio::table]] legacy_archive {
+            accumulator::mmr     acc;          // sorted digests archived so far
+            checksum256          last_leaf;    // greatest digest archived
+            uint64_t             last_epoch;   // epoch of the first `archlegacy`, no legacy digest is from a later block
+         };
+
+         // structure used for deposits that a cancel may refund directly, recorded while direct refunds are set
+         // a cancel of a transfer from `beneficiary` returning `quantity` pays `owner` on this chain, see `_cancel`
+         // a withdrawal or cancel of the transfer from `beneficiary` back to `owner` settles the deposit and erases it
+         struct [[eosio::table]] deposit_lock {
+            uint64_t             id;   // leading bytes of the `lock_key` of the deposit, as `processed` rows
+            name                 owner;
+            extended_asset       quantity;
+            name                 beneficiary;
+            time_point_sec       locked;
+
+            uint64_t primary_key()const { return id; }
+            checksum256 by_return()const { return return_key(quantity, beneficiary); }
+            uint64_t by_locked()const { return locked.sec_since_epoch(); }
+         };
+
+         static checksum256 lock_key(const name& owner, const extended_asset& quantity, const name& beneficiary) {
+            return proofcheck::hash_of(std::make_tuple(owner, quantity, beneficiary));
+         }
+
+         // the deposits to `beneficiary` that a transfer from it returning `quantity` can settle
+         static checksum256 return_key(const extended_asset& quantity, const name& beneficiary) {
+            return proofcheck::hash_of(std::make_tuple(quantity, beneficiary));
+         }
+
+         // row id from the leading bytes of a digest, so unrelated inserts touch different rows
+         static uint64_t digest_id(const checksum256& digest) {
+            auto bytes = digest.extract_as_byte_array();
+            uint64_t id = 0;
+            for (int i = 0; i < 8; i++) id = (id << 8) | bytes[i];
+            return id;
+         }
+
+         static constexpr uint32_t EPOCH_SECONDS = 7 * 24 * 3600;
+         static constexpr uint64_t ARCHIVE_AFTER_EPOCHS = 4;
+
+         static constexpr uint8_t RESERVE_SHARDS = 16;
+
+         static uint64_t reserve_delta_id(const symbol_code& sym, const uint8_t shard) { return (uint64_t(shard) << 56) | sym.raw(); }
+         static uint8_t reserve_shard(const name& account) { return (account.value * 0x9E3779B97F4A7C15ULL) >> 60; }
+
+         asset get_reserve(const extended_symbol& sym);
+         void sub_reserve(const extended_asset& value, const name& account);
+         void add_reserve(const extended_asset& value, const name& account);
+
 
       public:
          using contract::contract;
@@ -103,6 +154,32 @@ namespace eosio {
            name             beneficiary;
          };
 
+         // structure returned by the user actions (`deposit`, `withdrawa`, `withdrawb`, `cancela`, `cancelb`)
+         struct opresult {
+           checksum256      receipt_digest;   // digest of the proven action receipt, empty for deposits
+           wraplock::xfer   transfer;         // the xfer emitted by a deposit or cancel, or redeemed by a withdrawal
+           asset            reserve;          // full reserve of the token after the action, `reserves` row and every shard
+           name             proof_type;       // "heavy" or "light", empty for deposits
+         };
+
+#if WRAPLOCK_LIGHT_PROOFS
+         // structure returned by `proofadvice`
+         struct proof_advice {
+           bool             light_available;   // a light proof (`withdrawb` / `cancelb`) can be used for the block
+           uint32_t         block_height;      // height of the bridge's stored proof to prove against
+           checksum256      root;              // block merkle root of that proof, the `root` of the light proof
+         };
+#endif
+
+         // one of the actions proven together by `withdrawm`, its merkle path is part of the shared multiproof
+         struct multiaction {
+           action                                                act;
+           bridgetypes::actreceipt                               receipt;
+           std::vector<char>                                     returnvalue;
+           std::optional<accumulator::nonmembership_witness>     witness;          // required once the block's epoch is archived
+           std::optional<accumulator::nonmembership_witness>     legacy_witness;   // required once the legacy digests are archived
+         };
+
          /**
           * Allows contract account to set which chains and associated bridge contracts are used for interchain transfers.
           *
@@ -130,45 +207,99 @@ namespace eosio {
          [[eosio::action]]
          void delcontract(const name& native_token_contract);
 
+#if WRAPLOCK_HEAVY_PROOFS
          /**
           * Allows `prover` account to redeem native tokens and send them to the beneficiary indentified in the `actionproof`.
           *
           * @param prover - the calling account whose ram is used for storing the action receipt digest to prevent replay attacks
           * @param blockproof - the heavy proof data structure
           * @param actionproof - the proof structure for the `emitxfer` action associated with the `retire` action on the wrapped tokens chain
+          * @param witness - proof that the action receipt is not among the archived digests of its epoch, only for epochs archived by `archive`
+          * @param legacy_witness - proof that the action receipt is not among the digests archived by `archlegacy`, only for blocks up to its
+          * `last_epoch`; either witness may be null when it is not required
+          *
+          * @return the receipt digest, redeemed xfer, reserve after withdrawal and proof type used
+          */
+         [[eosio::action]]
+         wraplock::opresult withdrawa(const name& prover, ignore<bridgetypes::heavyproof> blockproof, ignore<bridgetypes::actionproof> actionproof, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> witness, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> legacy_witness);
+
+         /**
+          * Allows `prover` account to redeem several retirements of the same block at once. The bridge verifies the block
+          * alone (`checkproofd`), the actions are checked here against its action_mroot with one multiproof.
+          *
+          * @param prover - the calling account whose ram is used for storing the action receipt digests to prevent replay attacks
+          * @param blockproof - the heavy proof data structure
+          * @param actions - the `emitxfer` actions associated with the `retire` actions on the wrapped tokens chain, with their receipts
+          * @param proof - the merkle multiproof of the action receipts, `proof.indices` in the same order as `actions`
+          *
+          * @return the result of each withdrawal, in the order of `actions`
           */
          [[eosio::action]]
-         void withdrawa(const name& prover, const bridge::heavyproof blockproof, const bridge::actionproof actionproof);
+         std::vector<wraplock::opresult> withdrawm(const name& prover, ignore<bridgetypes::heavyproof> blockproof, ignore<std::vector<wraplock::multiaction>> actions, ignore<proofcheck::multiproof> proof);
+#endif
 
+#if WRAPLOCK_LIGHT_PROOFS
          /**
           * Allows `prover` account to redeem native tokens and send them to the beneficiary indentified in the `actionproof`.
           *
           * @param prover - the calling account whose ram is used for storing the action receipt digest to prevent replay attacks
           * @param blockproof - the light proof data structure
           * @param actionproof - the proof structure for the `emitxfer` action associated with the `retire` action on the wrapped tokens chain
+          * @param witness - proof that the action receipt is not among the archived digests of its epoch, only for epochs archived by `archive`
+          * @param legacy_witness - proof that the action receipt is not among the digests archived by `archlegacy`, only for blocks up to its
+          * `last_epoch`; either witness may be null when it is not required
+          *
+          * @return the receipt digest, redeemed xfer, reserve after withdrawal and proof type used
           */
          [[eosio::action]]
-         void withdrawb(const name& prover, const bridge::lightproof blockproof, const bridge::actionproof actionproof);
-      
+         wraplock::opresult withdrawb(const name& prover, ignore<bridgetypes::lightproof> blockproof, ignore<bridgetypes::actionproof> actionproof, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> witness, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> legacy_witness);
+#endif
+
+#if WRAPLOCK_HEAVY_PROOFS
          /**
           * Allows `prover` account to cancel a token transfer and return them to the beneficiary indentified in the `actionproof`.
           *
           * @param prover - the calling account whose ram is used for storing the action receipt digest to prevent replay attacks
           * @param blockproof - the heavy proof data structure
           * @param actionproof - the proof structure for the `emitxfer` action associated with the retiring transfer action on the native chain
+          * @param witness - proof that the action receipt is not among the archived digests of its epoch, only for epochs archived by `archive`
+          * @param legacy_witness - proof that the action receipt is not among the digests archived by `archlegacy`, only for blocks up to its
+          * `last_epoch`; either witness may be null when it is not required
+          *
+          * @return the receipt digest, emitted (or directly refunded, see `setrefund`) xfer, current reserve and proof type used
           */
          [[eosio::action]]
-         void cancela(const name& prover, const bridge::heavyproof blockproof, const bridge::actionproof actionproof);
+         wraplock::opresult cancela(const name& prover, ignore<bridgetypes::heavyproof> blockproof, ignore<bridgetypes::actionproof> actionproof, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> witness, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> legacy_witness);
+#endif
 
+#if WRAPLOCK_LIGHT_PROOFS
          /**
           * Allows `prover` account to cancel a token transfer and return them to the beneficiary indentified in the `actionproof`.
           *
           * @param prover - the calling account whose ram is used for storing the action receipt digest to prevent replay attacks
           * @param blockproof - the light proof data structure
           * @param actionproof - the proof structure for the `emitxfer` action associated with the retiring transfer action on the native chain
+          * @param witness - proof that the action receipt is not among the archived digests of its epoch, only for epochs archived by `archive`
+          * @param legacy_witness - proof that the action receipt is not among the digests archived by `archlegacy`, only for blocks up to its
+          * `last_epoch`; either witness may be null when it is not required
+          *
+          * @return the receipt digest, emitted (or directly refunded, see `setrefund`) xfer, current reserve and proof type used
           */
          [[eosio::action]]
-         void cancelb(const name& prover, const bridge::lightproof blockproof, const bridge::actionproof actionproof);
+         wraplock::opresult cancelb(const name& prover, ignore<bridgetypes::lightproof> blockproof, ignore<bridgetypes::actionproof> actionproof, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> witness, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> legacy_witness);
+
+         /**
+          * Tells relayers whether a block of the paired chain can already be proven with a light proof, from the proofs
+          * stored by the bridge (`lastproofs` table). If not, a heavy proof (`withdrawa` / `cancela`) is required.
+          * Only part of contracts built with light proofs.
+          *
+          * @param block_height - height of the block holding the action to prove
+          *
+          * @return whether a light proof is possible, and the height and merkle root of the stored proof to use
+          */
+         [[eosio::action, eosio::read_only]]
+         wraplock::proof_advice proofadvice(const uint32_t block_height);
+#endif
 
          /**
           * The inline action created by this contract when tokens are locked. Proof of this action is used on the wrapped token chain.
@@ -187,6 +318,73 @@ namespace eosio {
           */
          [[eosio::action]]
          void enable();
+
+         /**
+          * Folds the sharded reserve deltas of a token into its `reserves` row. Can be called by anyone, and is optional: withdrawals
+          * draw on the shard of their own account, then on the other shards, then on the `reserves` row, so deposits are available
+          * to them right away. Compacting only gathers the deltas back into one row.
+          *
+          * @param token_contract - the native token contract
+          * @param sym_code - the symbol code of the token
+          */
+         [[eosio::action]]
+         void compact(const name& token_contract, const symbol_code& sym_code);
+
+         /**
+          * Allows contract account to fold the `processed` digests of an old epoch into its merkle accumulator, releasing the rows.
+          * Can be called repeatedly until the epoch is fully archived. Proofs of actions in archived epochs must then carry a
+          * non-membership witness against the accumulator.
+          *
+          * @param epoch - the epoch to archive, the proven block time divided by `EPOCH_SECONDS`
+          * @param max_rows - maximum number of digests to archive in this call
+          */
+         [[eosio::action]]
+         void archive(const uint64_t epoch, const uint32_t max_rows);
+
+         /**
+          * Allows contract account to fold the `processed` digests in scope of the contract, accepted before epochs were
+          * introduced, into their own merkle accumulator, releasing the rows. Can be called repeatedly until the scope is empty.
+          * Proofs of actions in blocks up to the epoch of the first call must then carry a `legacy_witness` against it.
+          *
+          * @param max_rows - maximum number of digests to archive in this call
+          */
+         [[eosio::action]]
+         void archlegacy(const uint32_t max_rows);
+
+         /**
+          * Allows contract account to choose how cancels are settled. With direct refunds, deposits are recorded in `locks`,
+          * and a cancelled transfer back to the account that made such a deposit releases the tokens from the reserve to
+          * that account right away. When the transfer back names no account that can be paid here, they are released to
+          * an account recorded as depositing the same quantity to its owner. Other cancels emit an `xfer` back to the
+          * owner on the paired chain, which needs another proof.
+          *
+          * @param direct - true for direct refunds, false to always emit an `xfer` back to the owner
+          */
+         [[eosio::action]]
+         void setrefund(const bool direct);
+
+         /**
+          * Allows contract account to release the `locks` rows recorded before `before`, oldest first. Cancels of the
+          * deposits they cover then emit an `xfer` instead of refunding directly.
+          *
+          * @param before - locks recorded before this time are released
+          * @param max_rows - maximum number of locks to release in this call
+          */
+         [[eosio::action]]
+         void prunelocks(const time_point_sec& before, const uint32_t max_rows);
+
+         /**
+          * Allows contract account to bulk load table rows from a snapshot chunk (see include/snapshot.hpp) while the contract
+          * is disabled. An imported `global` row is stored disabled, `enable` once every chunk is loaded. Rows already present
+          * are overwritten, so a chunk can be imported again after a failed or partial run.
+          *
+          * @param table - the table the rows belong to (`global`, `contractmap`, `reserves`, `resdeltas`, `processed`, `archives`,
+          * `legacyarc` or `locks`)
+          * @param scope - the scope of the rows
+          * @param rows - the rows back to back, serialized as stored by this contract
+          */
+         [[eosio::action]]
+         void importrows(const name& table, const uint64_t scope, ignore<std::vector<char>> rows);
          
          /**
           * Allows contract account to clear existing state except which chains and associated contracts are used.
@@ -203,38 +401,97 @@ namespace eosio {
           * @param to - this contract account
           * @param quantity - the asset to be sent to the wrapped token chain
           * @param memo - the beneficiary account on the wrapped token chain
+          *
+          * Sets an `opresult` action return value for locking transfers.
           */
          [[eosio::on_notify("*::transfer")]] void deposit(name from, name to, asset quantity, string memo);
 
          using transfer_action = action_wrapper<"transfer"_n, &token::transfer>;
-         using heavyproof_action = action_wrapper<"checkproofb"_n, &bridge::checkproofb>;
-         using lightproof_action = action_wrapper<"checkproofc"_n, &bridge::checkproofc>;
          using emitxfer_action = action_wrapper<"emitxfer"_n, &wraplock::emitxfer>;
 
+#if WRAPLOCK_HEAVY_PROOFS
+         // heavy proving scheme: full block proof, passed inline to `checkproofe`
+         struct heavy_proof_policy {
+            static constexpr name type = "heavy"_n;
+            static constexpr name check_action = "checkproofe"_n;
+            static constexpr name block_action = "checkproofd"_n;   // block only, for `withdrawm`
+
+            template<typename DS>
+            static void read(DS& ds, checksum256& chain_id, block_timestamp& timestamp) { proofstream::read_heavyproof(ds, chain_id, timestamp); }
+         };
+#endif
+
+#if WRAPLOCK_LIGHT_PROOFS
+         // light proving scheme: block header against a root already proven on the bridge, passed inline to `checkprooff`
+         struct light_proof_policy {
+            static constexpr name type = "light"_n;
+            static constexpr name check_action = "checkprooff"_n;
+
+            template<typename DS>
+            static void read(DS& ds, checksum256& chain_id, block_timestamp& timestamp) { proofstream::read_lightproof(ds, chain_id, timestamp); }
+         };
+#endif
+
          typedef eosio::multi_index< "reserves"_n, account > reserves;
+         typedef eosio::multi_index< "resdeltas"_n, reserve_delta > reservedeltas;
          typedef eosio::multi_index< "contractmap"_n, contract_mapping,
             indexed_by<"wraptoken"_n, const_mem_fun<contract_mapping, uint64_t, &contract_mapping::by_paired_wraptoken_contract>> > contractmapping;
       
          typedef eosio::multi_index< "processed"_n, processed,
             indexed_by<"digest"_n, const_mem_fun<processed, checksum256, &processed::by_digest>>> processedtable;
 
+         typedef eosio::multi_index< "archives"_n, archived_epoch > archivedepochs;
+
+         using legacyarchive = eosio::singleton<"legacyarc"_n, legacy_archive>;
+
+         typedef eosio::multi_index< "locks"_n, deposit_lock,
+            indexed_by<"return"_n, const_mem_fun<deposit_lock, checksum256, &deposit_lock::by_return>>,
+            indexed_by<"locked"_n, const_mem_fun<deposit_lock, uint64_t, &deposit_lock::by_locked>>> locks;
+
          using globaltable = eosio::singleton<"global"_n, global>;
 
          globaltable global_config;
 
-         processedtable _processedtable;
+         processedtable _processedtable; // digests accepted before epochs were introduced
          contractmapping _contractmappingtable;
 
          wraplock( name receiver, name code, datastream<const char*> ds ) :
          contract(receiver, code, ds),
          global_config(_self, _self.value),
          _processedtable(_self, _self.value),
-         _contractmappingtable(_self, _self.value),
-         _light_proof(receiver, receiver.value),
-         _heavy_proof(receiver, receiver.value)
+         _contractmappingtable(_self, _self.value)
          {
 
          }
+
+      private:
+         // action proven by an `actionproof`, read from the raw action data
+         struct proven_action {
+            action                                                act;
+            checksum256                                           receipt_digest;
+            block_timestamp                                       timestamp;   // of the block holding the action
+            std::optional<accumulator::nonmembership_witness>     witness;          // required once the block's epoch is archived
+            std::optional<accumulator::nonmembership_witness>     legacy_witness;   // required once the legacy digests are archived
+         };
+
+         // reads the block proof and action proof following `prover` in the action data, checks them and forwards
+         // their raw bytes to the bridge for verification, see `heavy_proof_policy` / `light_proof_policy`
+         template<typename ProofPolicy>
+         proven_action check_proof(const name& prover, const bool is_cancel);
+
+         bool direct_refund();
+
+         void add_or_assert(const proven_action& proven, const name& payer);
+
+         // erases the lock of the deposit of `redeem_act.beneficiary` to `redeem_act.owner` that `redeem_act` returns,
+         // with `any_owner` of another deposit to `redeem_act.owner` of the same quantity when there is none
+         std::optional<deposit_lock> take_lock(const wraplock::xfer& redeem_act, const bool any_owner);
+
+         template<typename Table, typename Row>
+         uint32_t import_rows(const uint64_t scope, datastream<const char*>& ds);
+
+         opresult _withdraw(const name& prover, const proven_action& proven, const name& proof_type);
+         opresult _cancel(const name& prover, const proven_action& proven, const name& proof_type);
         
    };
 
@@ -0,0 +1,14 @@
+# post build check of the contract instantiation cost, run with -DNODE=<node> -DWASM=<path to wasm> -DBUDGET=<microseconds>
+# the median of repeated compiles and instantiations in node (see instantiation_benchmark.js), 0 only reports it
+execute_process(
+   COMMAND ${NODE} ${CMAKE_CURRENT_LIST_DIR}/instantiation_benchmark.js ${WASM}
+   OUTPUT_VARIABLE BENCHMARK_OUTPUT
+   RESULT_VARIABLE BENCHMARK_RESULT )
+if(NOT BENCHMARK_RESULT EQUAL 0 OR NOT BENCHMARK_OUTPUT MATCHES "instantiation_us ([0-9]+)")
+   message(FATAL_ERROR "instantiation benchmark of ${WASM} failed: ${BENCHMARK_OUTPUT}")
+endif()
+set(INSTANTIATION_US ${CMAKE_MATCH_1})
+if(BUDGET GREATER 0 AND INSTANTIATION_US GREATER BUDGET)
+   message(FATAL_ERROR "${WASM} takes ${INSTANTIATION_US} us to instantiate, over the ${BUDGET} us budget (WRAPLOCK_INSTANTIATION_BUDGET)")
+endif()
+message(STATUS "${WASM} takes ${INSTANTIATION_US} us to instantiate, budget ${BUDGET} us")
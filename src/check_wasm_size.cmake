@@ -0,0 +1,6 @@
+# post build check of the contract size, run with -DWASM=<path to wasm> -DBUDGET=<bytes>
+file(SIZE ${WASM} WASM_SIZE)
+if(WASM_SIZE GREATER BUDGET)
+   message(FATAL_ERROR "${WASM} is ${WASM_SIZE} bytes, over the ${BUDGET} bytes budget (WRAPLOCK_WASM_SIZE_BUDGET, or WRAPLOCK_LEAN_WASM_SIZE_BUDGET for lean builds)")
+endif()
+message(STATUS "${WASM} is ${WASM_SIZE} bytes, budget ${BUDGET} bytes")
@@ -0,0 +1,37 @@
+// Instantiation cost of a contract wasm, as a stand-in for the module compile and instantiation a node pays when a
+// contract is loaded: compiles and instantiates the module `runs` times with stub imports, and prints the median in
+// microseconds. Run with `node instantiation_benchmark.js <wasm> [runs]`, see check_wasm_instantiation.cmake.
+
+const fs = require('fs');
+
+const path = process.argv[2];
+const runs = Math.max(1, parseInt(process.argv[3] || '50', 10));
+const bytes = fs.readFileSync(path);
+
+// the intrinsics the contract imports are never called, instantiation only needs something to bind
+function stubs(module) {
+   const imports = {};
+   for (const i of WebAssembly.Module.imports(module)) {
+      imports[i.module] = imports[i.module] || {};
+      if (i.kind === 'function') imports[i.module][i.name] = () => 0;
+      else if (i.kind === 'memory') imports[i.module][i.name] = new WebAssembly.Memory({ initial: 1 });
+      else if (i.kind === 'table') imports[i.module][i.name] = new WebAssembly.Table({ initial: 0, element: 'anyfunc' });
+      else if (i.kind === 'global') imports[i.module][i.name] = 0;
+   }
+   return imports;
+}
+
+const imports = stubs(new WebAssembly.Module(bytes));
+
+// one untimed run, so the first measurement does not include warming up the engine itself
+new WebAssembly.Instance(new WebAssembly.Module(bytes), imports);
+
+const samples = [];
+for (let r = 0; r < runs; r++) {
+   const start = process.hrtime.bigint();
+   new WebAssembly.Instance(new WebAssembly.Module(bytes), imports);
+   samples.push(Number(process.hrtime.bigint() - start) / 1000);
+}
+samples.sort((a, b) => a - b);
+
+console.log(`instantiation_us ${Math.round(samples[Math.floor(samples.length / 2)])}`);
@@ -1,29 +1,132 @@
 #include <wraplock.hpp>
+#include <trace.hpp>
+#include <profiling.hpp>
+
+WRAPLOCK_PROFILING_DEFINE_ALLOCATOR()
 
 namespace eosio {
 
 
 //adds a proof to the list of processed proofs (throws an exception if proof already exists)
-void wraplock::add_or_assert(const bridge::actionproof& actionproof, const name& payer){
+void wraplock::add_or_assert(const proven_action& proven, const name& payer){
+    WRAPLOCK_PROFILE_STAGE("processed");
+    const checksum256& action_receipt_digest = proven.receipt_digest;
 
-    auto pid_index = _processedtable.get_index<"digest"_n>();
+    auto legacy_index = _processedtable.get_index<"digest"_n>();
+    check(legacy_index.find(action_receipt_digest) == legacy_index.end(), "action already proved");
 
-    std::vector<char> serializedAction = pack(actionproof.action);
-    std::vector<char> serializedReceipt = pack(actionproof.receipt);
-    checksum256 action_digest = sha256(serializedAction.data(), serializedAction.size());
-    checksum256 action_receipt_digest = sha256(serializedReceipt.data(), serializedReceipt.size());
+    uint64_t epoch = proven.timestamp.to_time_point().sec_since_epoch() / EPOCH_SECONDS;
+    processedtable _epochtable( _self, epoch );
+    auto pid_index = _epochtable.get_index<"digest"_n>();
 
     auto p_itr = pid_index.find(action_receipt_digest);
 
     check(p_itr == pid_index.end(), "action already proved");
 
-    _processedtable.emplace( payer, [&]( auto& s ) {
-        s.id = _processedtable.available_primary_key();
+    // digests up to the last archived one only remain in the accumulator, the proof must show it is not among them
+    archivedepochs _archivestable( _self, _self.value );
+    auto arc = _archivestable.find( epoch );
+    if (arc != _archivestable.end() && !(arc->last_leaf < action_receipt_digest)) {
+      check(proven.witness.has_value(), "epoch archived, proof requires a non-membership witness");
+      check(arc->acc.excludes(action_receipt_digest, *proven.witness), "action already proved or invalid non-membership witness");
+    }
+
+    // same for the legacy digests folded out of the contract scope, all of them from blocks up to `last_epoch`
+    legacyarchive _legacyarchive( _self, _self.value );
+    if (_legacyarchive.exists()) {
+      auto legacy = _legacyarchive.get();
+      if (epoch <= legacy.last_epoch && !(legacy.last_leaf < action_receipt_digest)) {
+        check(proven.legacy_witness.has_value(), "legacy digests archived, proof requires a legacy non-membership witness");
+        check(legacy.acc.excludes(action_receipt_digest, *proven.legacy_witness), "action already proved or invalid legacy non-membership witness");
+      }
+    }
+
+    // key rows by the leading bytes of the digest instead of `available_primary_key()`, probing past the rare collision
+    uint64_t id = digest_id(action_receipt_digest);
+    while (_epochtable.find(id) != _epochtable.end()) id++;
+
+    _epochtable.emplace( payer, [&]( auto& s ) {
+        s.id = id;
         s.receipt_digest = action_receipt_digest;
     });
 
 }
 
+//folds the processed digests of an epoch, in ascending order, into the epoch's accumulator
+void wraplock::archive(const uint64_t epoch, const uint32_t max_rows){
+
+    check(global_config.exists(), "contract must be initialized first");
+
+    require_auth(_self);
+
+    uint64_t current_epoch = current_time_point().sec_since_epoch() / EPOCH_SECONDS;
+    check(epoch + ARCHIVE_AFTER_EPOCHS <= current_epoch, "epoch too recent to archive");
+
+    archivedepochs _archivestable( _self, _self.value );
+    auto arc = _archivestable.find( epoch );
+    if (arc == _archivestable.end()) {
+      arc = _archivestable.emplace( _self, [&]( auto& a ){
+        a.epoch = epoch;
+      });
+    }
+
+    accumulator::mmr acc = arc->acc;
+    checksum256 last_leaf = arc->last_leaf;
+
+    // digests below the last archived one were accepted late, with a witness, and stay as rows
+    processedtable _epochtable( _self, epoch );
+    auto pid_index = _epochtable.get_index<"digest"_n>();
+    auto itr = acc.leaf_count == 0 ? pid_index.begin() : pid_index.upper_bound( last_leaf );
+
+    uint32_t count = 0;
+    while (itr != pid_index.end() && count < max_rows) {
+      acc.append(itr->receipt_digest);
+      last_leaf = itr->receipt_digest;
+      itr = pid_index.erase(itr);
+      count++;
+    }
+    check(count > 0, "nothing to archive");
+
+    WRAPLOCK_TRACE(info, archive, "archived", "epoch", epoch, "rows", count, "total", acc.leaf_count);
+
+    _archivestable.modify( arc, _self, [&]( auto& a ) {
+      a.acc = acc;
+      a.last_leaf = last_leaf;
+    });
+
+}
+
+//folds the processed digests accepted before epochs were introduced, in ascending order, into the legacy accumulator
+void wraplock::archlegacy(const uint32_t max_rows){
+
+    check(global_config.exists(), "contract must be initialized first");
+
+    require_auth(_self);
+
+    // digests are only added to epoch scopes now, every legacy digest is from a block before the current epoch
+    legacyarchive _legacyarchive( _self, _self.value );
+    legacy_archive legacy;
+    if (_legacyarchive.exists()) legacy = _legacyarchive.get();
+    else legacy.last_epoch = current_time_point().sec_since_epoch() / EPOCH_SECONDS;
+
+    auto pid_index = _processedtable.get_index<"digest"_n>();
+    auto itr = legacy.acc.leaf_count == 0 ? pid_index.begin() : pid_index.upper_bound( legacy.last_leaf );
+
+    uint32_t count = 0;
+    while (itr != pid_index.end() && count < max_rows) {
+      legacy.acc.append(itr->receipt_digest);
+      legacy.last_leaf = itr->receipt_digest;
+      itr = pid_index.erase(itr);
+      count++;
+    }
+    check(count > 0, "nothing to archive");
+
+    WRAPLOCK_TRACE(info, archive, "legacy archived", "rows", count, "total", legacy.acc.leaf_count);
+
+    _legacyarchive.set(legacy, _self);
+
+}
+
 void wraplock::init(const checksum256& chain_id, const name& bridge_contract, const checksum256& paired_chain_id)
 {
     check(!global_config.exists(), "contract already initialized");
@@ -107,47 +210,233 @@ void wraplock::enable(){
 
 }
 
-void wraplock::sub_reserve( const extended_asset& value ){
+//full reserve of a token: the `reserves` row plus every shard, as every shard backs withdrawals, see `sub_reserve`
+asset wraplock::get_reserve( const extended_symbol& sym ){
+   WRAPLOCK_PROFILE_STAGE("reserves");
+   asset balance{0, sym.get_symbol()};
 
-   reserves _reservestable( _self, value.contract.value );
-   const auto& res = _reservestable.get( value.quantity.symbol.code().raw(), "no balance object found" );
-   check( res.balance.amount >= value.quantity.amount, "overdrawn balance" );
+   reserves _reservestable( _self, sym.get_contract().value );
+   auto res = _reservestable.find( sym.get_symbol().code().raw() );
+   if( res != _reservestable.end() ) balance = res->balance;
 
-   _reservestable.modify( res, _self, [&]( auto& a ) {
-         a.balance -= value.quantity;
-      });
+   reservedeltas _deltastable( _self, sym.get_contract().value );
+   for( uint8_t shard = 0; shard < RESERVE_SHARDS; shard++ ) {
+      auto d = _deltastable.find( reserve_delta_id(sym.get_symbol().code(), shard) );
+      if( d != _deltastable.end() ) balance += d->delta;
+   }
+
+   return balance;
 }
 
-void wraplock::add_reserve(const extended_asset& value){
+//takes `value` from the shard of `account` first, then from the other shards, and from the `reserves` row last: a
+//withdrawal only writes the shared row once the deltas are used up, and never waits for `compact`
+void wraplock::sub_reserve( const extended_asset& value, const name& account ){
+   WRAPLOCK_PROFILE_STAGE("reserves");
+   reservedeltas _deltastable( _self, value.contract.value );
+   auto sym_code = value.quantity.symbol.code();
+   int64_t remaining = value.quantity.amount;
+
+   uint8_t own_shard = reserve_shard(account);
+   for( uint8_t i = 0; i < RESERVE_SHARDS && remaining > 0; i++ ) {
+      auto d = _deltastable.find( reserve_delta_id(sym_code, (own_shard + i) % RESERVE_SHARDS) );
+      if( d == _deltastable.end() ) continue;
+
+      int64_t from_shard = std::min( d->delta.amount, remaining );
+      remaining -= from_shard;
+      if( from_shard == d->delta.amount ) _deltastable.erase(d);
+      else {
+         _deltastable.modify( d, _self, [&]( auto& a ) {
+           a.delta.amount -= from_shard;
+         });
+      }
+   }
+
+   if( remaining == 0 ) return;
 
    reserves _reservestable( _self, value.contract.value );
-   auto res = _reservestable.find(  value.quantity.symbol.code().raw() );
-   if( res == _reservestable.end() ) {
-      _reservestable.emplace( _self, [&]( auto& a ){
-        a.balance = value.quantity;
+   auto res = _reservestable.find( sym_code.raw() );
+   check( res != _reservestable.end() && res->balance.amount >= remaining, "overdrawn balance" );
+   _reservestable.modify( res, _self, [&]( auto& a ) {
+     a.balance.amount -= remaining;
+   });
+}
+
+//records a deposit in the shard of `account`, drawn on by withdrawals and folded into `reserves` by `compact`
+void wraplock::add_reserve(const extended_asset& value, const name& account){
+   WRAPLOCK_PROFILE_STAGE("reserves");
+   reservedeltas _deltastable( _self, value.contract.value );
+   auto id = reserve_delta_id( value.quantity.symbol.code(), reserve_shard(account) );
+   auto d = _deltastable.find( id );
+   if( d == _deltastable.end() ) {
+      _deltastable.emplace( _self, [&]( auto& a ){
+        a.id = id;
+        a.delta = value.quantity;
       });
    } else {
-      _reservestable.modify( res, _self, [&]( auto& a ) {
-        a.balance += value.quantity;
+      _deltastable.modify( d, _self, [&]( auto& a ) {
+        a.delta += value.quantity;
       });
    }
 
 }
 
+//folds the reserve deltas of a token into its reserves row
+void wraplock::compact(const name& token_contract, const symbol_code& sym_code){
+
+    check(global_config.exists(), "contract must be initialized first");
+
+    reservedeltas _deltastable( _self, token_contract.value );
+    reserves _reservestable( _self, token_contract.value );
+
+    for (uint8_t shard = 0; shard < RESERVE_SHARDS; shard++) {
+      auto d = _deltastable.find( reserve_delta_id(sym_code, shard) );
+      if( d == _deltastable.end() ) continue;
+
+      auto res = _reservestable.find( sym_code.raw() );
+      if( res == _reservestable.end() ) {
+        _reservestable.emplace( _self, [&]( auto& a ){
+          a.balance = d->delta;
+        });
+      } else {
+        _reservestable.modify( res, _self, [&]( auto& a ) {
+          a.balance += d->delta;
+        });
+      }
+
+      _deltastable.erase(d);
+    }
+
+}
+
+bool wraplock::direct_refund(){
+    auto global = global_config.get();
+    return global.direct_refund.has_value() && global.direct_refund.value();
+}
+
+//Set how cancels are settled.
+void wraplock::setrefund(const bool direct){
+
+    check(global_config.exists(), "contract must be initialized first");
+
+    require_auth(_self);
+
+    auto global = global_config.get();
+    global.direct_refund.emplace(direct);
+    global_config.set(global, _self);
+
+    WRAPLOCK_TRACE(info, admin, "refund mode set", "direct", direct);
+
+}
+
+std::optional<wraplock::deposit_lock> wraplock::take_lock(const wraplock::xfer& redeem_act, const bool any_owner){
+    WRAPLOCK_PROFILE_STAGE("locks");
+
+    locks _locks( _self, _self.value );
+    auto lock_index = _locks.get_index<"return"_n>();
+    auto key = return_key(redeem_act.quantity, redeem_act.owner);
+    auto lock = lock_index.end();
+    for (auto itr = lock_index.find(key); itr != lock_index.end() && itr->by_return() == key; itr++) {
+      if (itr->owner == redeem_act.beneficiary) {
+        lock = itr;
+        break;
+      }
+      if (any_owner && lock == lock_index.end()) lock = itr;
+    }
+    if (lock == lock_index.end()) return std::nullopt;
+
+    deposit_lock taken = *lock;
+    lock_index.erase(lock);
+    return taken;
+}
+
+//Release the oldest deposit locks.
+void wraplock::prunelocks(const time_point_sec& before, const uint32_t max_rows){
+
+    require_auth(_self);
+
+    locks _locks( _self, _self.value );
+    auto locked_index = _locks.get_index<"locked"_n>();
+    uint32_t count = 0;
+    for (auto itr = locked_index.begin(); itr != locked_index.end() && itr->locked < before && count < max_rows; count++) itr = locked_index.erase(itr);
+    check(count > 0, "nothing to prune");
+
+    WRAPLOCK_TRACE(info, admin, "locks pruned", "rows", count);
+
+}
+
+template<typename Table, typename Row>
+uint32_t wraplock::import_rows(const uint64_t scope, datastream<const char*>& ds){
+    Table table( _self, scope );
+    uint32_t count = 0;
+    while (ds.remaining() > 0) {
+      Row row;
+      ds >> row;
+      // a row loaded by an earlier attempt at the same chunk is overwritten, so chunks can be retried
+      auto itr = table.find( row.primary_key() );
+      if (itr == table.end()) table.emplace( _self, [&]( auto& r ){ r = row; });
+      else table.modify( itr, _self, [&]( auto& r ){ r = row; });
+      count++;
+    }
+    return count;
+}
+
+//Bulk load rows of a snapshot chunk.
+void wraplock::importrows(const name& table, const uint64_t scope, ignore<std::vector<char>> rows){
+
+    require_auth(_self);
+
+    if (global_config.exists()) check(global_config.get().enabled == false, "contract must be disabled while importing");
+
+    auto& ds = get_datastream();
+    uint32_t size = proofstream::read_varuint(ds);
+    check(ds.remaining() == size, "malformed rows");
+
+    uint32_t count = 1;
+    if (table == "global"_n) {
+      check(scope == _self.value, "global is scoped by the contract");
+      global g;
+      ds >> g;
+      g.enabled = false;
+      global_config.set(g, _self);
+    }
+    else if (table == "contractmap"_n) count = import_rows<contractmapping, contract_mapping>(scope, ds);
+    else if (table == "reserves"_n) count = import_rows<reserves, account>(scope, ds);
+    else if (table == "resdeltas"_n) count = import_rows<reservedeltas, reserve_delta>(scope, ds);
+    else if (table == "processed"_n) count = import_rows<processedtable, processed>(scope, ds);
+    else if (table == "archives"_n) count = import_rows<archivedepochs, archived_epoch>(scope, ds);
+    else if (table == "locks"_n) count = import_rows<locks, deposit_lock>(scope, ds);
+    else if (table == "legacyarc"_n) {
+      check(scope == _self.value, "legacyarc is scoped by the contract");
+      legacy_archive legacy;
+      ds >> legacy;
+      legacyarchive(_self, _self.value).set(legacy, _self);
+    }
+    else check(false, "unknown table");
+
+    check(ds.remaining() == 0, "malformed rows");
+
+    WRAPLOCK_TRACE(info, admin, "rows imported", "table", table, "scope", scope, "rows", count);
+
+}
+
 // called on transfer action to lock tokens and initiate interchain transfer
 void wraplock::deposit(name from, name to, asset quantity, string memo)
 { 
+    WRAPLOCK_PROFILE_STAGE("deposit");
 
-    print("transfer ", name{from}, " ",  name{to}, " ", quantity, "\n");
-    print("sender: ", get_sender(), "\n");
+    WRAPLOCK_TRACE(debug, deposit, "transfer", "from", from, "to", to, "quantity", quantity, "sender", get_sender());
     
+    WRAPLOCK_PROFILE_BEGIN("global_config");
     check(global_config.exists(), "contract must be initialized first");
     auto global = global_config.get();
+    WRAPLOCK_PROFILE_END();
 
     check(global.enabled == true, "contract has been disabled");
 
+    WRAPLOCK_PROFILE_BEGIN("contractmap");
     auto contractmap = _contractmappingtable.find( get_sender().value );
     check(contractmap != _contractmappingtable.end(), "transfer not permitted from unauthorised token contract");
+    WRAPLOCK_PROFILE_END();
 
     //if incoming transfer
     if (from == "eosio.stake"_n) return ; //ignore unstaking transfers
@@ -159,161 +448,319 @@ void wraplock::deposit(name from, name to, asset quantity, string memo)
 
       check(quantity.amount > 0, "must lock positive quantity");
 
-      add_reserve( extended_asset{quantity, get_sender()} );
-
       wraplock::xfer x = {
         .owner = from,
         .quantity = extended_asset(quantity, get_sender()),
         .beneficiary = name(memo)
       };
 
+      add_reserve( x.quantity, from );
+
+      // a cancel of the transfer back from the beneficiary can then refund `from` directly, see `_cancel`
+      if (direct_refund()) {
+        WRAPLOCK_PROFILE_STAGE("locks");
+        locks _locks( _self, _self.value );
+        uint64_t id = digest_id(lock_key(x.owner, x.quantity, x.beneficiary));
+        while (_locks.find(id) != _locks.end()) id++;
+        _locks.emplace( _self, [&]( auto& l ){
+          l.id = id;
+          l.owner = x.owner;
+          l.quantity = x.quantity;
+          l.beneficiary = x.beneficiary;
+          l.locked = current_time_point();
+        });
+      }
+
+      WRAPLOCK_PROFILE_BEGIN("inline_actions");
       wraplock::emitxfer_action act(_self, permission_level{_self, "active"_n});
       act.send(x);
+      WRAPLOCK_PROFILE_END();
+
+      WRAPLOCK_TRACE(info, deposit, "locked", "owner", x.owner, "quantity", x.quantity.quantity, "beneficiary", x.beneficiary);
+
+      wraplock::opresult result = {
+        .transfer = x,
+        .reserve = get_reserve( extended_symbol{quantity.symbol, get_sender()} )
+      };
+      //notification handlers have no return value of their own, so the result is set through the host function directly
+      //CDT only declares it in `internal_use_do_not_use`, it is the same call the dispatcher makes for returning actions
+      WRAPLOCK_PROFILE_BEGIN("return_value");
+      auto packed = pack(result);
+      internal_use_do_not_use::set_action_return_value(packed.data(), packed.size());
+      WRAPLOCK_PROFILE_END();
 
     }
 
 }
 
-void wraplock::_withdraw(const name& prover, const bridge::actionproof actionproof){
+wraplock::opresult wraplock::_withdraw(const name& prover, const proven_action& proven, const name& proof_type){
     auto global = global_config.get();
 
+    WRAPLOCK_PROFILE_BEGIN("contractmap");
     auto contractmap_index = _contractmappingtable.get_index<"wraptoken"_n>();
-    auto contractmap = contractmap_index.find( actionproof.action.account.value );
+    auto contractmap = contractmap_index.find( proven.act.account.value );
     check(contractmap != contractmap_index.end(), "proof account does not match paired account");
+    WRAPLOCK_PROFILE_END();
+
+    WRAPLOCK_PROFILE_BEGIN("deserialize");
+    wraplock::xfer redeem_act = unpack<wraplock::xfer>(proven.act.data);
+    WRAPLOCK_PROFILE_END();
 
-    wraplock::xfer redeem_act = unpack<wraplock::xfer>(actionproof.action.data);
+    add_or_assert(proven, prover);
 
-    add_or_assert(actionproof, prover);
+    check(proven.act.name == "emitxfer"_n, "must provide proof of token retiring before withdrawing");
 
-    check(actionproof.action.name == "emitxfer"_n, "must provide proof of token retiring before withdrawing");
+    sub_reserve( extended_asset{redeem_act.quantity.quantity, redeem_act.quantity.contract}, redeem_act.beneficiary );
 
-    sub_reserve( extended_asset{redeem_act.quantity.quantity, redeem_act.quantity.contract} );
+    // the tokens of a recorded deposit sent back to its owner have left the reserve, a cancel can no longer refund them
+    take_lock(redeem_act, false);
 
+    WRAPLOCK_PROFILE_BEGIN("inline_actions");
     wraplock::transfer_action act(redeem_act.quantity.contract, permission_level{_self, "active"_n});
     act.send(_self, redeem_act.beneficiary, redeem_act.quantity.quantity, std::string("") );
+    WRAPLOCK_PROFILE_END();
+
+    WRAPLOCK_TRACE(info, withdraw, "released", "beneficiary", redeem_act.beneficiary, "quantity", redeem_act.quantity.quantity, "proof", proof_type, "digest", proven.receipt_digest);
+
+    return { proven.receipt_digest, redeem_act, get_reserve( redeem_act.quantity.get_extended_symbol() ), proof_type };
 
 }
 
-// withdraw tokens (requires a heavy proof of retiring)
-void wraplock::withdrawa(const name& prover, const bridge::heavyproof blockproof, const bridge::actionproof actionproof){
+// common checks for a proven action, then hands the block proof over to the bridge for verification
+// will fail tx if proof is invalid
+//
+// only the fields needed here are read from the serialized proofs, the bridge receives their raw bytes
+template<typename ProofPolicy>
+wraplock::proven_action wraplock::check_proof(const name& prover, const bool is_cancel){
     require_auth(prover);
 
+    WRAPLOCK_PROFILE_BEGIN("global_config");
     check(global_config.exists(), "contract must be initialized first");
     auto global = global_config.get();
+    WRAPLOCK_PROFILE_END();
 
     check(global.enabled == true, "contract has been disabled");
 
-    check(blockproof.chain_id == global.paired_chain_id, "proof chain does not match paired chain");
-
-    // check proof against bridge
-    // will fail tx if prove is invalid
-    auto p = _heavy_proof.get_or_create(_self, _heavy_proof_obj);
-    p.hp = blockproof;
-    _heavy_proof.set(p, _self);
-    wraplock::heavyproof_action checkproof_act(global.bridge_contract, permission_level{_self, "active"_n});
-    checkproof_act.send(_self, actionproof);
+    WRAPLOCK_PROFILE_BEGIN("deserialize");
+    auto& ds = get_datastream();
+    const char* proofs_start = ds.pos();
+
+    checksum256 chain_id;
+    block_timestamp timestamp;
+    ProofPolicy::read(ds, chain_id, timestamp);
+    check(ds.valid(), "malformed block proof");
+    WRAPLOCK_PROFILE_END();
+
+    check(chain_id == global.paired_chain_id, "proof chain does not match paired chain");
+
+    if (is_cancel) check(current_time_point().sec_since_epoch() > timestamp.to_time_point().sec_since_epoch() + 900, "must wait 15 minutes to cancel");
+
+    WRAPLOCK_PROFILE_BEGIN("deserialize");
+    proven_action proven;
+    proven.timestamp = timestamp;
+    proofstream::read_actionproof(ds, proven.act, proven.receipt_digest);
+    check(ds.valid(), "malformed action proof");
+    const char* proofs_end = ds.pos();
+
+    // both witnesses are optional trailing arguments, each may be null so the legacy witness can be sent on its own
+    if (ds.remaining() > 0) ds >> proven.witness;
+    if (ds.remaining() > 0) ds >> proven.legacy_witness;
+    check(ds.valid(), "malformed non-membership witness");
+    WRAPLOCK_PROFILE_END();
+
+    // the block proof travels in the inline action itself, so concurrent provers share no staging row
+    WRAPLOCK_PROFILE_BEGIN("bridge_handoff");
+    action checkproof_act;
+    checkproof_act.account = global.bridge_contract;
+    checkproof_act.name = ProofPolicy::check_action;
+    checkproof_act.authorization = { permission_level{_self, "active"_n} };
+    checkproof_act.data.assign(proofs_start, proofs_end);
+    checkproof_act.send();
+    WRAPLOCK_PROFILE_END();
+
+    return proven;
+}
 
-    _withdraw(prover, actionproof);
+#if WRAPLOCK_HEAVY_PROOFS
+// withdraw tokens (requires a heavy proof of retiring)
+wraplock::opresult wraplock::withdrawa(const name& prover, ignore<bridgetypes::heavyproof> blockproof, ignore<bridgetypes::actionproof> actionproof, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> witness, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> legacy_witness){
+    WRAPLOCK_PROFILE_STAGE("withdrawa");
+    auto proven = check_proof<heavy_proof_policy>(prover, false);
+    return _withdraw(prover, proven, heavy_proof_policy::type);
 }
 
-// withdraw tokens (requires a light proof of retiring)
-void wraplock::withdrawb(const name& prover, const bridge::lightproof blockproof, const bridge::actionproof actionproof){
+// withdraw several tokens retired in the same block (requires a heavy proof of the block and a multiproof of the actions)
+std::vector<wraplock::opresult> wraplock::withdrawm(const name& prover, ignore<bridgetypes::heavyproof> blockproof, ignore<std::vector<wraplock::multiaction>> actions, ignore<proofcheck::multiproof> proof){
+    WRAPLOCK_PROFILE_STAGE("withdrawm");
     require_auth(prover);
 
     check(global_config.exists(), "contract must be initialized first");
     auto global = global_config.get();
-
     check(global.enabled == true, "contract has been disabled");
 
-    check(blockproof.chain_id == global.paired_chain_id, "proof chain does not match paired chain");
+    WRAPLOCK_PROFILE_BEGIN("deserialize");
+    auto& ds = get_datastream();
+    const char* proof_start = ds.pos();
+
+    checksum256 chain_id, previous, action_mroot;
+    block_timestamp timestamp;
+    proofstream::read_heavyproof(ds, chain_id, timestamp, &previous, &action_mroot);
+    check(ds.valid(), "malformed block proof");
+    const char* proof_end = ds.pos();
+    check(chain_id == global.paired_chain_id, "proof chain does not match paired chain");
+
+    std::vector<wraplock::multiaction> proven_actions;
+    proofcheck::multiproof paths;
+    ds >> proven_actions;
+    ds >> paths;
+    check(ds.valid(), "malformed action proofs");
+    check(!proven_actions.empty() && proven_actions.size() == paths.indices.size(), "one multiproof index required per action");
+    WRAPLOCK_PROFILE_END();
+
+    // the bridge checks the block alone, the action receipts are checked here against its action_mroot
+    WRAPLOCK_PROFILE_BEGIN("bridge_handoff");
+    action checkproof_act;
+    checkproof_act.account = global.bridge_contract;
+    checkproof_act.name = heavy_proof_policy::block_action;
+    checkproof_act.authorization = { permission_level{_self, "active"_n} };
+    checkproof_act.data.assign(proof_start, proof_end);
+    checkproof_act.send();
+    WRAPLOCK_PROFILE_END();
+
+    bridgetypes::chainstable _chainstable( global.bridge_contract, global.bridge_contract.value );
+    auto chain_index = _chainstable.get_index<"chainid"_n>();
+    auto chain = chain_index.find( global.paired_chain_id );
+    check(chain != chain_index.end(), "paired chain not registered on bridge");
+
+    uint32_t block_num = bridgetypes::get_block_num_from_id(previous) + 1;
+    bool return_value_activated = chain->return_value_activated != 0 && block_num >= chain->return_value_activated;
+
+    // keyed on the canonical receipt digest like check_proof, so each action is proven once whatever the entry point
+    WRAPLOCK_PROFILE_BEGIN("digest");
+    std::vector<checksum256> receipt_digests;
+    for (const auto& a : proven_actions) {
+      check(proofcheck::action_digest(a.act, a.returnvalue, return_value_activated) == a.receipt.act_digest, "action digest does not match receipt");
+      receipt_digests.push_back(proofcheck::receipt_digest(a.receipt));
+    }
 
-    // check proof against bridge
-    // will fail tx if prove is invalid
-    auto p = _light_proof.get_or_create(_self, _light_proof_obj);
-    p.lp = blockproof;
-    _light_proof.set(p, _self);
-    wraplock::lightproof_action checkproof_act(global.bridge_contract, permission_level{_self, "active"_n});
-    checkproof_act.send(_self, actionproof);
+    auto root = proofcheck::multiproof_root(paths, receipt_digests);
+    check(root.has_value() && *root == action_mroot, "multiproof does not match action_mroot");
+    WRAPLOCK_PROFILE_END();
 
-    _withdraw(prover, actionproof);
+    std::vector<wraplock::opresult> results;
+    for (size_t i = 0; i < proven_actions.size(); i++) {
+      proven_action proven{ proven_actions[i].act, receipt_digests[i], timestamp, proven_actions[i].witness, proven_actions[i].legacy_witness };
+      results.push_back(_withdraw(prover, proven, heavy_proof_policy::type));
+    }
+
+    return results;
 }
+#endif
 
-void wraplock::_cancel(const name& prover, const bridge::actionproof actionproof)
+#if WRAPLOCK_LIGHT_PROOFS
+// withdraw tokens (requires a light proof of retiring)
+wraplock::opresult wraplock::withdrawb(const name& prover, ignore<bridgetypes::lightproof> blockproof, ignore<bridgetypes::actionproof> actionproof, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> witness, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> legacy_witness){
+    WRAPLOCK_PROFILE_STAGE("withdrawb");
+    auto proven = check_proof<light_proof_policy>(prover, false);
+    return _withdraw(prover, proven, light_proof_policy::type);
+}
+#endif
+
+wraplock::opresult wraplock::_cancel(const name& prover, const proven_action& proven, const name& proof_type)
 {
     auto global = global_config.get();
 
+    WRAPLOCK_PROFILE_BEGIN("contractmap");
     auto contractmap_index = _contractmappingtable.get_index<"wraptoken"_n>();
-    auto contractmap = contractmap_index.find( actionproof.action.account.value );
+    auto contractmap = contractmap_index.find( proven.act.account.value );
     check(contractmap != contractmap_index.end(), "proof account does not match paired account");
+    WRAPLOCK_PROFILE_END();
 
-    wraplock::xfer redeem_act = unpack<wraplock::xfer>(actionproof.action.data);
+    WRAPLOCK_PROFILE_BEGIN("deserialize");
+    wraplock::xfer redeem_act = unpack<wraplock::xfer>(proven.act.data);
+    WRAPLOCK_PROFILE_END();
 
-    add_or_assert(actionproof, prover);
+    add_or_assert(proven, prover);
 
     auto sym = redeem_act.quantity.quantity.symbol;
     check( sym.is_valid(), "invalid symbol name" );
 
-    check(actionproof.action.name == "emitxfer"_n, "must provide proof of token retiring before cancelling");
+    check(proven.act.name == "emitxfer"_n, "must provide proof of token retiring before cancelling");
 
+    // the owner of an xfer is where the tokens leave from: the reserve, as redeem_act.beneficiary never received them
     wraplock::xfer x = {
-      .owner = _self, // todo - check whether this should show as redeem_act.beneficiary
+      .owner = _self,
       .quantity = extended_asset(redeem_act.quantity.quantity, redeem_act.quantity.contract),
       .beneficiary = redeem_act.owner
     };
 
-    // return to redeem_act.owner so can be withdrawn from wraplock
-    wraplock::emitxfer_action act(_self, permission_level{_self, "active"_n});
-    act.send(x);
+    // redeem_act.owner is a paired chain name, the same name here may belong to someone else or to nobody; a direct
+    // refund only pays the account of this chain recorded as depositing to redeem_act.owner: redeem_act.beneficiary
+    // when the cancelled transfer was sending the tokens back to it, any such depositor when it cannot be paid here
+    // the lock of the deposit is erased either way, its tokens are refunded or returned to the paired chain
+    bool payable = is_account(redeem_act.beneficiary) && redeem_act.beneficiary != _self;
+    auto lock = take_lock(redeem_act, direct_refund() && !payable);
 
-}
+    if (lock && direct_refund()) {
+      x.beneficiary = lock->owner;
+      sub_reserve( x.quantity, x.beneficiary );
 
-void wraplock::cancela(const name& prover, const bridge::heavyproof blockproof, const bridge::actionproof actionproof)
-{
-    require_auth(prover);
+      wraplock::transfer_action act(x.quantity.contract, permission_level{_self, "active"_n});
+      act.send(_self, x.beneficiary, x.quantity.quantity, std::string("") );
 
-    check(global_config.exists(), "contract must be initialized first");
-    auto global = global_config.get();
-
-    check(global.enabled == true, "contract has been disabled");
+      WRAPLOCK_TRACE(info, cancel, "refunded", "owner", x.beneficiary, "quantity", x.quantity.quantity, "proof", proof_type, "digest", proven.receipt_digest);
+    }
+    else {
+      // return to redeem_act.owner so can be withdrawn from wraplock
+      wraplock::emitxfer_action act(_self, permission_level{_self, "active"_n});
+      act.send(x);
 
-    check(blockproof.chain_id == global.paired_chain_id, "proof chain does not match paired chain");
+      WRAPLOCK_TRACE(info, cancel, "cancelled", "owner", redeem_act.owner, "quantity", x.quantity.quantity, "proof", proof_type, "digest", proven.receipt_digest);
+    }
 
-    check(current_time_point().sec_since_epoch() > blockproof.blocktoprove.block.header.timestamp.to_time_point().sec_since_epoch() + 900, "must wait 15 minutes to cancel");
+    return { proven.receipt_digest, x, get_reserve( x.quantity.get_extended_symbol() ), proof_type };
 
-    // check proof against bridge
-    // will fail tx if prove is invalid
-    auto p = _heavy_proof.get_or_create(_self, _heavy_proof_obj);
-    p.hp = blockproof;
-    _heavy_proof.set(p, _self);
-    wraplock::heavyproof_action checkproof_act(global.bridge_contract, permission_level{_self, "active"_n});
-    checkproof_act.send(_self, actionproof);
+}
 
-    _cancel(prover, actionproof);
+#if WRAPLOCK_HEAVY_PROOFS
+wraplock::opresult wraplock::cancela(const name& prover, ignore<bridgetypes::heavyproof> blockproof, ignore<bridgetypes::actionproof> actionproof, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> witness, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> legacy_witness)
+{
+    WRAPLOCK_PROFILE_STAGE("cancela");
+    auto proven = check_proof<heavy_proof_policy>(prover, true);
+    return _cancel(prover, proven, heavy_proof_policy::type);
 }
+#endif
 
-void wraplock::cancelb(const name& prover, const bridge::lightproof blockproof, const bridge::actionproof actionproof)
+#if WRAPLOCK_LIGHT_PROOFS
+wraplock::opresult wraplock::cancelb(const name& prover, ignore<bridgetypes::lightproof> blockproof, ignore<bridgetypes::actionproof> actionproof, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> witness, ignore<binary_extension<std::optional<accumulator::nonmembership_witness>>> legacy_witness)
 {
-    require_auth(prover);
+    WRAPLOCK_PROFILE_STAGE("cancelb");
+    auto proven = check_proof<light_proof_policy>(prover, true);
+    return _cancel(prover, proven, light_proof_policy::type);
+}
 
+//finds the earliest unexpired proof stored by the bridge covering `block_height`, which a light proof can be built against
+wraplock::proof_advice wraplock::proofadvice(const uint32_t block_height)
+{
     check(global_config.exists(), "contract must be initialized first");
     auto global = global_config.get();
 
-    check(global.enabled == true, "contract has been disabled");
-
-    check(blockproof.chain_id == global.paired_chain_id, "proof chain does not match paired chain");
+    bridgetypes::chainstable _chainstable( global.bridge_contract, global.bridge_contract.value );
+    auto chain_index = _chainstable.get_index<"chainid"_n>();
+    auto chain = chain_index.find( global.paired_chain_id );
+    check(chain != chain_index.end(), "paired chain not registered on bridge");
 
-    check(current_time_point().sec_since_epoch() > blockproof.header.timestamp.to_time_point().sec_since_epoch() + 900, "must wait 15 minutes to cancel");
+    bridgetypes::proofstable _proofstable( global.bridge_contract, chain->name.value );
+    auto height_index = _proofstable.get_index<"height"_n>();
+    auto now = current_time_point();
 
-    // check proof against bridge
-    // will fail tx if prove is invalid
-    auto p = _light_proof.get_or_create(_self, _light_proof_obj);
-    p.lp = blockproof;
-    _light_proof.set(p, _self);
-    wraplock::lightproof_action checkproof_act(global.bridge_contract, permission_level{_self, "active"_n});
-    checkproof_act.send(_self, actionproof);
+    for (auto itr = height_index.lower_bound( block_height ); itr != height_index.end(); itr++) {
+      if (itr->expiry > now) return { true, itr->block_height, itr->block_merkle_root };
+    }
 
-    _cancel(prover, actionproof);
+    return { false, 0, checksum256() };
 }
+#endif
 
 
 /*void wraplock::clear()
@@ -340,8 +787,6 @@ void wraplock::cancelb(const name& prover, const bridge::lightproof blockproof,
     _processedtable.erase(itr);
   }
 
-  if (_light_proof.exists()) _light_proof.remove();
-  if (_heavy_proof.exists()) _heavy_proof.remove();
 
 }*/
 
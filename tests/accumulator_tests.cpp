@@ -0,0 +1,141 @@
+#include <accumulator.hpp>
+
+#include <testing.hpp>
+
+using namespace eosio;
+
+namespace {
+
+   // `count` distinct digests in ascending order, as `archive` appends them
+   std::vector<checksum256> sorted_leaves(const uint32_t count) {
+      std::vector<checksum256> leaves;
+      for (uint32_t i = 0; i < count; i++) leaves.push_back(proofcheck::hash_of(i));
+      std::sort(leaves.begin(), leaves.end());
+      return leaves;
+   }
+
+   accumulator::mmr append_all(const std::vector<checksum256>& leaves) {
+      accumulator::mmr acc;
+      for (const auto& l : leaves) acc.append(l);
+      return acc;
+   }
+
+   // a digest strictly between the leaves at `lo` and `lo + 1`: the lower one plus one
+   checksum256 between(const std::vector<checksum256>& leaves, const size_t lo) {
+      auto bytes = leaves[lo].extract_as_byte_array();
+      for (int i = 31; i >= 0; i--) if (++bytes[i] != 0) break;
+      checksum256 digest(bytes);
+      REQUIRE(leaves[lo] < digest && digest < leaves[lo + 1]);
+      return digest;
+   }
+
+}
+
+TEST_CASE(append_and_prove_round_trip) {
+   for (uint32_t count = 1; count <= 33; count++) {
+      auto leaves = sorted_leaves(count);
+      auto acc = append_all(leaves);
+      REQUIRE(acc.leaf_count == count && acc.peaks.size() == size_t(__builtin_popcount(count)));
+
+      for (uint32_t i = 0; i < count; i++) {
+         auto proof = accumulator::prove(leaves, i);
+         REQUIRE(acc.contains(i, proof));
+
+         // the same proof at another index, or with its leaf replaced, does not verify
+         REQUIRE(!acc.contains((i + 1) % count, proof) || count == 1);
+         auto other = proof;
+         other.leaf = proofcheck::hash_of(count + i);
+         REQUIRE(!acc.contains(i, other));
+      }
+      REQUIRE(!acc.contains(count, accumulator::prove(leaves, count - 1)));
+   }
+}
+
+TEST_CASE(proofs_of_a_shorter_range_fail_after_more_appends) {
+   auto leaves = sorted_leaves(12);
+   auto acc = append_all(std::vector<checksum256>(leaves.begin(), leaves.begin() + 7));
+   auto proof = accumulator::prove(std::vector<checksum256>(leaves.begin(), leaves.begin() + 7), 5);
+   REQUIRE(acc.contains(5, proof));
+
+   for (size_t i = 7; i < leaves.size(); i++) acc.append(leaves[i]);
+   REQUIRE(!acc.contains(5, proof));
+   REQUIRE(acc.contains(5, accumulator::prove(leaves, 5)));
+}
+
+TEST_CASE(excludes_digests_between_adjacent_leaves) {
+   auto leaves = sorted_leaves(21);
+   auto acc = append_all(leaves);
+
+   for (size_t lo = 0; lo + 1 < leaves.size(); lo++) {
+      auto digest = between(leaves, lo);
+      auto w = accumulator::witness(leaves, digest);
+      REQUIRE(w.has_value() && w->hi_index == lo + 1 && w->lo.has_value());
+      REQUIRE(acc.excludes(digest, *w));
+   }
+
+   // archived digests have no witness
+   for (const auto& l : leaves) REQUIRE(!accumulator::witness(leaves, l).has_value());
+}
+
+TEST_CASE(forged_adjacent_leaf_witness_is_rejected) {
+   auto leaves = sorted_leaves(21);
+   auto acc = append_all(leaves);
+   const size_t archived = 9;
+   const auto& digest = leaves[archived];
+
+   // the leaves on either side of an archived digest, each with a valid membership proof, are not adjacent
+   accumulator::nonmembership_witness skipping{ archived + 1, accumulator::prove(leaves, archived + 1), accumulator::prove(leaves, archived - 1) };
+   REQUIRE(!acc.excludes(digest, skipping));
+
+   // nor does giving the lower one the path of hi_index - 1, a path only verifies with the leaf it was built for
+   accumulator::nonmembership_witness relabelled = skipping;
+   relabelled.lo->path = accumulator::prove(leaves, archived).path;
+   REQUIRE(!acc.excludes(digest, relabelled));
+
+   // the true neighbours of the digest itself do not exclude it: it is not strictly between them
+   accumulator::nonmembership_witness neighbours{ archived, accumulator::prove(leaves, archived), accumulator::prove(leaves, archived - 1) };
+   REQUIRE(!acc.excludes(digest, neighbours));
+
+   // a lower leaf above the digest is refused
+   auto below = between(leaves, archived - 1);
+   accumulator::nonmembership_witness inverted{ archived, accumulator::prove(leaves, archived), accumulator::prove(leaves, archived - 1) };
+   REQUIRE(acc.excludes(below, inverted));
+   inverted.lo = accumulator::prove(leaves, archived);
+   REQUIRE(!acc.excludes(below, inverted));
+}
+
+TEST_CASE(boundary_leaves) {
+   auto leaves = sorted_leaves(16);
+   auto acc = append_all(leaves);
+
+   // below the first leaf: hi_index 0 and no lower leaf
+   std::array<uint8_t, 32> zero{};
+   checksum256 lowest(zero);
+   REQUIRE(lowest < leaves.front());
+   auto w = accumulator::witness(leaves, lowest);
+   REQUIRE(w.has_value() && w->hi_index == 0 && !w->lo.has_value());
+   REQUIRE(acc.excludes(lowest, *w));
+
+   // the first leaf itself, claimed as below the first leaf, is refused
+   REQUIRE(!acc.excludes(leaves.front(), *w));
+
+   // a lower leaf is still required whenever hi_index is above 0
+   auto missing_lo = *accumulator::witness(leaves, between(leaves, 0));
+   REQUIRE(acc.excludes(between(leaves, 0), missing_lo));
+   missing_lo.lo.reset();
+   REQUIRE(!acc.excludes(between(leaves, 0), missing_lo));
+
+   // above the last leaf no witness exists, the contract compares against its `last_leaf` instead
+   std::array<uint8_t, 32> ones;
+   ones.fill(0xff);
+   checksum256 highest(ones);
+   REQUIRE(!accumulator::witness(leaves, highest).has_value());
+
+   // and the last leaf cannot be excluded with the leaf below it as hi
+   accumulator::nonmembership_witness last{ 15, accumulator::prove(leaves, 15), accumulator::prove(leaves, 14) };
+   REQUIRE(!acc.excludes(leaves.back(), last));
+
+   // an empty accumulator contains nothing, so it excludes nothing either
+   accumulator::mmr empty;
+   REQUIRE(!empty.contains(0, accumulator::prove(leaves, 0)));
+}
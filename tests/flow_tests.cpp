@@ -0,0 +1,93 @@
+#include <wraplock_tester.hpp>
+
+#include <testing.hpp>
+
+using namespace eosio;
+using wraplocktest::eos;
+
+// deposit -> withdraw -> cancel across two fixture chains: wraplock runs on the native chain (wraplock_tester.hpp) and
+// proves paired chain blocks through its bridge, the xfers it emits are included in native chain blocks and checked
+// by the bridge of the paired chain, as wraptoken would before issuing
+
+namespace {
+
+   const std::vector<name> users = { "alice"_n, "bob"_n, "carol"_n, "dave"_n, "relayer"_n };
+
+   uint32_t block_time(const chainfixture::chain& c, const uint32_t block_num) {
+      return c.heavy_proof(block_num).blocktoprove.block.header.timestamp.to_time_point().sec_since_epoch();
+   }
+
+   void produce(chainfixture::chain& c, const uint32_t blocks) { for (uint32_t n = 0; n < blocks; n++) c.produce_block(); }
+
+}
+
+TEST_CASE(deposit_withdraw_and_cancel_between_two_chains) {
+   const std::vector<name> producers = { "prod.a"_n, "prod.b"_n, "prod.c"_n };
+   chainfixture::chain native(proofcheck::hash("native chain", 12), producers);
+   auto paired = testing::paired_chain(0, producers);
+
+   chainfixture::mock_bridge native_bridge(native);   // on the paired chain, proving native blocks
+   wraplocktest::tester t(paired, users);             // wraplock on the native chain, proving paired blocks
+
+   // deposits lock tokens in the reserve, the xfers they emit land in native chain blocks
+   auto deposit = [&](const name& owner, const int64_t amount, const name& beneficiary) {
+      t.issue(owner, asset(amount, eos));
+      REQUIRE(t.transfer(owner, t.self, asset(amount, eos), beneficiary.to_string()) == "");
+      auto emitted = t.emitted();
+      REQUIRE(emitted.size() == 1);
+      native.push_action(chainfixture::emitxfer(t.self, emitted[0].owner, emitted[0].quantity, emitted[0].beneficiary));
+      return native.produce_block();
+   };
+   uint32_t issued_deposit = deposit("alice"_n, 10000, "bob"_n);
+   deposit("carol"_n, 5000, "dave"_n);
+   produce(native, 4);
+   REQUIRE(t.reserve() == 15000 && t.balance("alice"_n) == 0 && t.balance("carol"_n) == 0);
+
+   // wraptoken issues for the first deposit on a proof the paired chain's bridge accepts
+   auto issue = native.action_proof(issued_deposit, 0);
+   REQUIRE(native_bridge.checkproofe(native.heavy_proof(issued_deposit), issue) == nullptr);
+   auto issued = unpack<wraplock::xfer>(issue.action.data);
+   REQUIRE(issue.action.account == t.self && issued.owner == "alice"_n && issued.beneficiary == "bob"_n);
+   REQUIRE(issued.quantity == extended_asset(asset(10000, eos), t.token));
+
+   // bob retires on the paired chain and withdraws to alice's account on the native chain
+   testing::retire(paired, "bob"_n, 10000, "alice"_n);
+   uint32_t retired = paired.produce_block();
+
+   // the second deposit was never issued, wraptoken emits it back after the cancel period
+   testing::retire(paired, "dave"_n, 5000, "carol"_n);
+   uint32_t cancelled = paired.produce_block();
+
+   paired.push_action(chainfixture::emitxfer("fake.token"_n, "mallory"_n, extended_asset(asset(5000, eos), t.token), "alice"_n));
+   uint32_t forged = paired.produce_block();
+   produce(paired, 4);
+
+   auto prove = [&](const name& action_name, const chainfixture::chain& c, const uint32_t block) {
+      return t.act(action_name, "relayer"_n, "relayer"_n, c.heavy_proof(block), c.action_proof(block, 0));
+   };
+
+   REQUIRE(prove("withdrawa"_n, paired, retired) == "");
+   REQUIRE(t.result<wraplock::opresult>().transfer.beneficiary == "alice"_n);
+   REQUIRE(t.balance("alice"_n) == 10000 && t.reserve() == 5000);
+   REQUIRE(prove("withdrawa"_n, paired, retired) == "action already proved");
+
+   // a proof of the wrong chain, or an action of another contract, is refused
+   REQUIRE(prove("withdrawa"_n, native, issued_deposit) == "proof chain does not match paired chain");
+   REQUIRE(prove("withdrawa"_n, paired, forged) == "proof account does not match paired account");
+   REQUIRE(t.balance("alice"_n) == 10000 && t.reserve() == 5000);
+
+   // the cancel emits the xfer back to dave, whose deposit stays in the reserve until it is issued or withdrawn
+   uint32_t cancel_time = block_time(paired, cancelled);
+   t.set_time(time_point_sec(cancel_time + 600));
+   REQUIRE(prove("cancela"_n, paired, cancelled) == "must wait 15 minutes to cancel");
+   t.set_time(time_point_sec(cancel_time + 901));
+   REQUIRE(prove("cancela"_n, paired, cancelled) == "");
+   auto refunded = t.emitted();
+   REQUIRE(refunded.size() == 1 && refunded[0].owner == t.self && refunded[0].beneficiary == "dave"_n);
+   REQUIRE(refunded[0].quantity == extended_asset(asset(5000, eos), t.token));
+   REQUIRE(t.balance("carol"_n) == 0 && t.reserve() == 5000);
+
+   // a cancel proven once cannot be replayed, even as a withdrawal
+   REQUIRE(prove("cancela"_n, paired, cancelled) == "action already proved");
+   REQUIRE(prove("withdrawa"_n, paired, cancelled) == "action already proved");
+}
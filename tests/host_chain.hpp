@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <stdint.h>
+
+// In-memory chain behind the database, authorization, time and action intrinsics of host_intrinsics.cpp, so contract
+// code built with the host compiler runs against real tables. `state` holds the database, the existing accounts and
+// the time; `action_context` the action being applied, which collects the inline actions it sends. Tests apply one
+// action at a time through `begin_action` (see wraplock_tester.hpp), copying `state::db` to roll a transaction back.
+//
+// Iterators follow the chain's conventions: rows are numbered from 0, the end iterator of a table is -2 or below and
+// -1 stands for a table without rows. Secondary keys of 256 bits are two 128 bit words, as the CDT passes checksum256.
+
+namespace hostchain {
+
+   using key256 = std::array<unsigned __int128, 2>;
+   using table_id = std::tuple<uint64_t, uint64_t, uint64_t>;   // code, scope, table
+
+   struct row {
+      uint64_t             payer;
+      std::vector<char>    value;
+   };
+
+   template<typename Key>
+   struct secondary_rows {
+      std::map<uint64_t, std::pair<Key, uint64_t>>    by_primary;   // secondary key and payer of each primary key
+      std::set<std::pair<Key, uint64_t>>              ordered;      // by secondary key, then primary key
+   };
+
+   struct database {
+      std::map<table_id, std::map<uint64_t, row>>     tables;
+      std::map<table_id, secondary_rows<uint64_t>>    idx64;
+      std::map<table_id, secondary_rows<key256>>      idx256;
+   };
+
+   struct action_context {
+      uint64_t                            receiver = 0;
+      uint64_t                            first_receiver = 0;
+      uint64_t                            sender = 0;         // receiver of the action that sent this one, 0 at the top
+      std::vector<char>                   data;
+      std::set<uint64_t>                  authorizers;
+      std::vector<std::vector<char>>      inline_actions;     // packed, in the order sent
+      std::vector<char>                   return_value;
+      std::string                         console;
+   };
+
+   struct state {
+      database             db;
+      std::set<uint64_t>   accounts;
+      uint64_t             now = 0;   // microseconds since the epoch
+      action_context       context;
+   };
+
+   // the chain the intrinsics act on
+   state& current();
+
+   // makes `context` the action being applied, iterators of the previous action are released
+   void begin_action(action_context context);
+
+}
@@ -0,0 +1,410 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <host_chain.hpp>
+
+// Chain intrinsics reached by the host side headers and by contract code built for the host. A failed check throws, so
+// tests can expect rejections and proofcheck::verify_batch can report them. Hashing and key recovery have host
+// implementations of their own. The database, authorization and action intrinsics act on `hostchain::current()`.
+
+namespace {
+
+   using hostchain::key256;
+   using hostchain::table_id;
+
+   hostchain::state chain;
+
+   void fail(const std::string& message) { throw std::runtime_error(message); }
+
+   std::string name_string(uint64_t value) {
+      static const char* charmap = ".12345abcdefghijklmnopqrstuvwxyz";
+      std::string str(13, '.');
+      for (uint32_t i = 0; i <= 12; ++i) {
+         str[12 - i] = charmap[value & (i == 0 ? 0x0f : 0x1f)];
+         value >>= (i == 0 ? 4 : 5);
+      }
+      while (!str.empty() && str.back() == '.') str.pop_back();
+      return str;
+   }
+
+   int32_t end_handle(std::vector<table_id>& ends, const table_id& t) {
+      auto i = std::find(ends.begin(), ends.end(), t);
+      if (i == ends.end()) i = ends.insert(ends.end(), t);
+      return -int32_t(i - ends.begin()) - 2;
+   }
+
+   struct primary_index {
+      std::vector<std::pair<table_id, uint64_t>>   rows;
+      std::vector<table_id>                        ends;
+
+      void reset() { rows.clear(); ends.clear(); }
+
+      int32_t handle(const table_id& t, const uint64_t pk) {
+         rows.push_back({ t, pk });
+         return int32_t(rows.size() - 1);
+      }
+
+      const std::pair<table_id, uint64_t>& at(const int32_t itr) {
+         if (itr < 0 || size_t(itr) >= rows.size()) fail("invalid iterator");
+         return rows[itr];
+      }
+
+      std::map<uint64_t, hostchain::row>* find_table(const table_id& t) {
+         auto i = chain.db.tables.find(t);
+         return i == chain.db.tables.end() || i->second.empty() ? nullptr : &i->second;
+      }
+
+      hostchain::row& row_at(const int32_t itr, const bool write) {
+         const auto& [t, pk] = at(itr);
+         if (write && std::get<0>(t) != chain.context.receiver) fail("db access violation");
+         auto table = find_table(t);
+         if (!table || !table->count(pk)) fail("dereference of deleted object");
+         return table->at(pk);
+      }
+
+      template<typename Bound>
+      int32_t bound(const table_id& t, Bound&& b) {
+         auto table = find_table(t);
+         if (!table) return -1;
+         auto i = b(*table);
+         return i == table->end() ? end_handle(ends, t) : handle(t, i->first);
+      }
+   } primary;
+
+   template<typename Key>
+   struct secondary_index {
+      std::map<table_id, hostchain::secondary_rows<Key>>& (*tables)();
+      std::vector<std::tuple<table_id, Key, uint64_t>>     rows;
+      std::vector<table_id>                                ends;
+
+      void reset() { rows.clear(); ends.clear(); }
+
+      int32_t handle(const table_id& t, const Key& key, const uint64_t pk) {
+         rows.push_back({ t, key, pk });
+         return int32_t(rows.size() - 1);
+      }
+
+      hostchain::secondary_rows<Key>* find_table(const table_id& t) {
+         auto i = tables().find(t);
+         return i == tables().end() || i->second.by_primary.empty() ? nullptr : &i->second;
+      }
+
+      std::tuple<table_id, Key, uint64_t>& at(const int32_t itr, const bool write) {
+         if (itr < 0 || size_t(itr) >= rows.size()) fail("invalid secondary iterator");
+         if (write && std::get<0>(std::get<0>(rows[itr])) != chain.context.receiver) fail("db access violation");
+         return rows[itr];
+      }
+
+      int32_t store(const uint64_t scope, const uint64_t table, const uint64_t payer, const uint64_t id, const Key& key) {
+         table_id t{ chain.context.receiver, scope, table };
+         auto& s = tables()[t];
+         if (s.by_primary.count(id)) fail("secondary index row already exists for the primary key");
+         s.by_primary[id] = { key, payer };
+         s.ordered.insert({ key, id });
+         return handle(t, key, id);
+      }
+
+      void update(const int32_t itr, const uint64_t payer, const Key& key) {
+         auto& [t, old, pk] = at(itr, true);
+         auto& s = tables().at(t);
+         s.ordered.erase({ old, pk });
+         s.ordered.insert({ key, pk });
+         s.by_primary[pk] = { key, payer ? payer : s.by_primary[pk].second };
+         old = key;
+      }
+
+      void remove(const int32_t itr) {
+         auto [t, key, pk] = at(itr, true);
+         auto& s = tables().at(t);
+         s.ordered.erase({ key, pk });
+         s.by_primary.erase(pk);
+         if (s.by_primary.empty()) tables().erase(t);
+      }
+
+      int32_t next(const int32_t itr, uint64_t* primary_key) {
+         if (itr < 0) return -1;
+         auto [t, key, pk] = at(itr, false);
+         auto s = find_table(t);
+         if (!s) return -1;
+         auto i = s->ordered.upper_bound({ key, pk });
+         if (i == s->ordered.end()) return end_handle(ends, t);
+         *primary_key = i->second;
+         return handle(t, i->first, i->second);
+      }
+
+      int32_t previous(const int32_t itr, uint64_t* primary_key) {
+         if (itr == -1) return -1;
+         table_id t;
+         typename std::set<std::pair<Key, uint64_t>>::iterator i;
+         hostchain::secondary_rows<Key>* s;
+         if (itr < -1) {
+            t = ends.at(-itr - 2);
+            s = find_table(t);
+            if (!s) return -1;
+            i = s->ordered.end();
+         }
+         else {
+            auto [table, key, pk] = at(itr, false);
+            t = table;
+            s = find_table(t);
+            if (!s) return -1;
+            i = s->ordered.lower_bound({ key, pk });
+         }
+         if (i == s->ordered.begin()) return -1;
+         --i;
+         *primary_key = i->second;
+         return handle(t, i->first, i->second);
+      }
+
+      int32_t find_primary(const table_id& t, Key& key, const uint64_t pk) {
+         auto s = find_table(t);
+         if (!s) return -1;
+         auto i = s->by_primary.find(pk);
+         if (i == s->by_primary.end()) return end_handle(ends, t);
+         key = i->second.first;
+         return handle(t, key, pk);
+      }
+
+      int32_t find_secondary(const table_id& t, const Key& key, uint64_t* primary_key) {
+         auto s = find_table(t);
+         if (!s) return -1;
+         auto i = s->ordered.lower_bound({ key, 0 });
+         if (i == s->ordered.end() || i->first != key) return end_handle(ends, t);
+         *primary_key = i->second;
+         return handle(t, i->first, i->second);
+      }
+
+      int32_t lowerbound(const table_id& t, Key& key, uint64_t* primary_key, const bool upper) {
+         auto s = find_table(t);
+         if (!s) return -1;
+         auto i = upper ? s->ordered.upper_bound({ key, UINT64_MAX }) : s->ordered.lower_bound({ key, 0 });
+         if (i == s->ordered.end()) return end_handle(ends, t);
+         key = i->first;
+         *primary_key = i->second;
+         return handle(t, i->first, i->second);
+      }
+
+      int32_t end(const table_id& t) { return find_table(t) ? end_handle(ends, t) : -1; }
+   };
+
+   secondary_index<uint64_t> idx64{ []() -> auto& { return chain.db.idx64; }, {}, {} };
+   secondary_index<key256> idx256{ []() -> auto& { return chain.db.idx256; }, {}, {} };
+
+   key256 words(const unsigned __int128* data, const uint32_t len) {
+      if (len != 2) fail("invalid size of secondary key array");
+      return { data[0], data[1] };
+   }
+
+   void copy_words(const key256& key, unsigned __int128* data) { data[0] = key[0]; data[1] = key[1]; }
+
+}
+
+namespace hostchain {
+
+   state& current() { return chain; }
+
+   void begin_action(action_context context) {
+      chain.context = std::move(context);
+      primary.reset();
+      idx64.reset();
+      idx256.reset();
+   }
+
+}
+
+extern "C" {
+
+   void eosio_assert(uint32_t test, const char* msg) {
+      if (!test) throw std::runtime_error(msg);
+   }
+
+   void eosio_assert_message(uint32_t test, const char* msg, uint32_t msg_len) {
+      if (!test) throw std::runtime_error(std::string(msg, msg_len));
+   }
+
+   void eosio_assert_code(uint32_t test, uint64_t code) {
+      if (!test) throw std::runtime_error("assertion failure with code " + std::to_string(code));
+   }
+
+   // primary index
+
+   int32_t db_store_i64(uint64_t scope, uint64_t table, uint64_t payer, uint64_t id, const void* data, uint32_t len) {
+      table_id t{ chain.context.receiver, scope, table };
+      auto& rows = chain.db.tables[t];
+      if (rows.count(id)) fail("could not insert object, most likely a uniqueness constraint was violated");
+      rows[id] = { payer, std::vector<char>((const char*)data, (const char*)data + len) };
+      return primary.handle(t, id);
+   }
+
+   void db_update_i64(int32_t iterator, uint64_t payer, const void* data, uint32_t len) {
+      auto& r = primary.row_at(iterator, true);
+      r.value.assign((const char*)data, (const char*)data + len);
+      if (payer) r.payer = payer;
+   }
+
+   void db_remove_i64(int32_t iterator) {
+      primary.row_at(iterator, true);
+      const auto [t, pk] = primary.at(iterator);
+      auto& rows = chain.db.tables.at(t);
+      rows.erase(pk);
+      if (rows.empty()) chain.db.tables.erase(t);
+   }
+
+   int32_t db_get_i64(int32_t iterator, const void* data, uint32_t len) {
+      const auto& value = primary.row_at(iterator, false).value;
+      if (len) memcpy(const_cast<void*>(data), value.data(), std::min<size_t>(len, value.size()));
+      return int32_t(value.size());
+   }
+
+   int32_t db_next_i64(int32_t iterator, uint64_t* primary_key) {
+      if (iterator < 0) return -1;
+      const auto [t, pk] = primary.at(iterator);
+      return primary.bound(t, [&](auto& rows) {
+         auto i = rows.upper_bound(pk);
+         if (i != rows.end()) *primary_key = i->first;
+         return i;
+      });
+   }
+
+   int32_t db_previous_i64(int32_t iterator, uint64_t* primary_key) {
+      if (iterator == -1) return -1;
+      table_id t = iterator < -1 ? primary.ends.at(-iterator - 2) : primary.at(iterator).first;
+      auto rows = primary.find_table(t);
+      if (!rows) return -1;
+      auto i = iterator < -1 ? rows->end() : rows->lower_bound(primary.at(iterator).second);
+      if (i == rows->begin()) return -1;
+      --i;
+      *primary_key = i->first;
+      return primary.handle(t, i->first);
+   }
+
+   int32_t db_find_i64(uint64_t code, uint64_t scope, uint64_t table, uint64_t id) {
+      return primary.bound({ code, scope, table }, [&](auto& rows) { return rows.find(id); });
+   }
+
+   int32_t db_lowerbound_i64(uint64_t code, uint64_t scope, uint64_t table, uint64_t id) {
+      return primary.bound({ code, scope, table }, [&](auto& rows) { return rows.lower_bound(id); });
+   }
+
+   int32_t db_upperbound_i64(uint64_t code, uint64_t scope, uint64_t table, uint64_t id) {
+      return primary.bound({ code, scope, table }, [&](auto& rows) { return rows.upper_bound(id); });
+   }
+
+   int32_t db_end_i64(uint64_t code, uint64_t scope, uint64_t table) {
+      table_id t{ code, scope, table };
+      return primary.find_table(t) ? end_handle(primary.ends, t) : -1;
+   }
+
+   // 64 bit secondary index
+
+   int32_t db_idx64_store(uint64_t scope, uint64_t table, uint64_t payer, uint64_t id, const uint64_t* secondary) {
+      return idx64.store(scope, table, payer, id, *secondary);
+   }
+
+   void db_idx64_update(int32_t iterator, uint64_t payer, const uint64_t* secondary) { idx64.update(iterator, payer, *secondary); }
+
+   void db_idx64_remove(int32_t iterator) { idx64.remove(iterator); }
+
+   int32_t db_idx64_next(int32_t iterator, uint64_t* primary_key) { return idx64.next(iterator, primary_key); }
+
+   int32_t db_idx64_previous(int32_t iterator, uint64_t* primary_key) { return idx64.previous(iterator, primary_key); }
+
+   int32_t db_idx64_find_primary(uint64_t code, uint64_t scope, uint64_t table, uint64_t* secondary, uint64_t primary_key) {
+      return idx64.find_primary({ code, scope, table }, *secondary, primary_key);
+   }
+
+   int32_t db_idx64_find_secondary(uint64_t code, uint64_t scope, uint64_t table, const uint64_t* secondary, uint64_t* primary_key) {
+      return idx64.find_secondary({ code, scope, table }, *secondary, primary_key);
+   }
+
+   int32_t db_idx64_lowerbound(uint64_t code, uint64_t scope, uint64_t table, uint64_t* secondary, uint64_t* primary_key) {
+      return idx64.lowerbound({ code, scope, table }, *secondary, primary_key, false);
+   }
+
+   int32_t db_idx64_upperbound(uint64_t code, uint64_t scope, uint64_t table, uint64_t* secondary, uint64_t* primary_key) {
+      return idx64.lowerbound({ code, scope, table }, *secondary, primary_key, true);
+   }
+
+   int32_t db_idx64_end(uint64_t code, uint64_t scope, uint64_t table) { return idx64.end({ code, scope, table }); }
+
+   // 256 bit secondary index
+
+   int32_t db_idx256_store(uint64_t scope, uint64_t table, uint64_t payer, uint64_t id, const unsigned __int128* data, uint32_t data_len) {
+      return idx256.store(scope, table, payer, id, words(data, data_len));
+   }
+
+   void db_idx256_update(int32_t iterator, uint64_t payer, const unsigned __int128* data, uint32_t data_len) {
+      idx256.update(iterator, payer, words(data, data_len));
+   }
+
+   void db_idx256_remove(int32_t iterator) { idx256.remove(iterator); }
+
+   int32_t db_idx256_next(int32_t iterator, uint64_t* primary_key) { return idx256.next(iterator, primary_key); }
+
+   int32_t db_idx256_previous(int32_t iterator, uint64_t* primary_key) { return idx256.previous(iterator, primary_key); }
+
+   int32_t db_idx256_find_primary(uint64_t code, uint64_t scope, uint64_t table, unsigned __int128* data, uint32_t data_len, uint64_t primary_key) {
+      key256 key = words(data, data_len);
+      int32_t itr = idx256.find_primary({ code, scope, table }, key, primary_key);
+      copy_words(key, data);
+      return itr;
+   }
+
+   int32_t db_idx256_find_secondary(uint64_t code, uint64_t scope, uint64_t table, const unsigned __int128* data, uint32_t data_len, uint64_t* primary_key) {
+      return idx256.find_secondary({ code, scope, table }, words(data, data_len), primary_key);
+   }
+
+   int32_t db_idx256_lowerbound(uint64_t code, uint64_t scope, uint64_t table, unsigned __int128* data, uint32_t data_len, uint64_t* primary_key) {
+      key256 key = words(data, data_len);
+      int32_t itr = idx256.lowerbound({ code, scope, table }, key, primary_key, false);
+      copy_words(key, data);
+      return itr;
+   }
+
+   int32_t db_idx256_upperbound(uint64_t code, uint64_t scope, uint64_t table, unsigned __int128* data, uint32_t data_len, uint64_t* primary_key) {
+      key256 key = words(data, data_len);
+      int32_t itr = idx256.lowerbound({ code, scope, table }, key, primary_key, true);
+      copy_words(key, data);
+      return itr;
+   }
+
+   int32_t db_idx256_end(uint64_t code, uint64_t scope, uint64_t table) { return idx256.end({ code, scope, table }); }
+
+   // authorization, time and action
+
+   void require_auth(uint64_t name) {
+      if (!chain.context.authorizers.count(name)) fail("missing authority of " + name_string(name));
+   }
+
+   bool has_auth(uint64_t name) { return chain.context.authorizers.count(name) != 0; }
+
+   bool is_account(uint64_t name) { return chain.accounts.count(name) != 0; }
+
+   uint64_t current_time() { return chain.now; }
+
+   void send_inline(char* serialized_action, size_t size) { chain.context.inline_actions.emplace_back(serialized_action, serialized_action + size); }
+
+   uint32_t read_action_data(void* msg, uint32_t len) {
+      uint32_t size = std::min<uint32_t>(len, chain.context.data.size());
+      if (size) memcpy(msg, chain.context.data.data(), size);
+      return size;
+   }
+
+   uint32_t action_data_size() { return uint32_t(chain.context.data.size()); }
+
+   uint64_t get_sender() { return chain.context.sender; }
+
+   uint64_t current_receiver() { return chain.context.receiver; }
+
+   void set_action_return_value(void* return_value, size_t size) {
+      chain.context.return_value.assign((const char*)return_value, (const char*)return_value + size);
+   }
+
+   void prints_l(const char* cstr, uint32_t len) { chain.context.console.append(cstr, len); }
+
+}
@@ -0,0 +1,3 @@
+#include <testing.hpp>
+
+int main() { return testing::run_all(); }
@@ -0,0 +1,211 @@
+#include <chainfixture.hpp>
+#include <proofcheck.hpp>
+
+#include <testing.hpp>
+
+using namespace eosio;
+
+namespace {
+
+   const checksum256 chain_id = proofcheck::hash("paired chain", 12);
+
+   const std::vector<name> producers = { "prod.a"_n, "prod.b"_n, "prod.c"_n, "prod.d"_n };
+
+   checksum256 leaf(const uint32_t i) { return proofcheck::hash_of(i); }
+
+   std::vector<char> bytes(const checksum256& value) {
+      auto b = value.extract_as_byte_array();
+      return std::vector<char>(b.begin(), b.end());
+   }
+
+   proofcheck::chain_config make_config(const chainfixture::chain& c) {
+      proofcheck::chain_config config;
+      config.chain_id = c.chain_id();
+      config.return_value_activated = c.return_value_activated();
+      config.recover = chainfixture::test_recover;
+      config.schedules[0] = chainfixture::to_schedule(c.schedule(0));
+      return config;
+   }
+
+   std::string result_of(proofcheck::result r) { return r ? r : ""; }
+
+   checksum256 from_hex(const std::string& hex) {
+      std::array<uint8_t, 32> b{};
+      for (size_t i = 0; i < 32; i++) b[i] = uint8_t(std::stoul(hex.substr(2 * i, 2), nullptr, 16));
+      return checksum256(b);
+   }
+
+   checksum256 sha256(const std::string& message) { return proofcheck::hash(message.data(), message.size()); }
+
+}
+
+TEST_CASE(sha256_matches_published_vectors) {
+   REQUIRE(sha256("abc") == from_hex("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+   REQUIRE(sha256("") == from_hex("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"));
+   REQUIRE(sha256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") == from_hex("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"));
+}
+
+// expected values computed outside this code base, from the byte layouts alone
+TEST_CASE(merkle_root_and_signing_digest_match_known_vectors) {
+   REQUIRE(proofcheck::merkle_root({ sha256("a"), sha256("b"), sha256("c") }) == from_hex("ec5e7a8bc1d6d737228c3d16a84db6703a9ecc7a7a0bc3b02c05264f9c4f1eda"));
+   REQUIRE(proofcheck::signing_digest(sha256("header"), sha256("bmroot"), sha256("schedule")) == from_hex("d9eff2f81af7d513963b59c7b472b936d7be38b220eb21888d44c434ede3fa14"));
+}
+
+TEST_CASE(signing_digest_hashes_header_and_root_before_the_schedule) {
+   checksum256 header = leaf(1), bmroot = leaf(2), schedule = leaf(3);
+
+   std::vector<char> inner = bytes(header);
+   auto root_bytes = bytes(bmroot);
+   inner.insert(inner.end(), root_bytes.begin(), root_bytes.end());
+   std::vector<char> outer = bytes(proofcheck::hash(inner.data(), inner.size()));
+   auto schedule_bytes = bytes(schedule);
+   outer.insert(outer.end(), schedule_bytes.begin(), schedule_bytes.end());
+
+   REQUIRE(proofcheck::signing_digest(header, bmroot, schedule) == proofcheck::hash(outer.data(), outer.size()));
+}
+
+TEST_CASE(incremental_merkle_matches_merkle_root_and_validates_its_nodes) {
+   proofcheck::incremental_merkle m;
+   std::vector<checksum256> leaves;
+   REQUIRE(m.valid());
+
+   for (uint32_t i = 0; i < 70; i++) {
+      leaves.push_back(leaf(i));
+      m.append(leaves.back());
+      REQUIRE(m.root() == proofcheck::merkle_root(leaves));
+      REQUIRE(m.valid());
+
+      if (m.active_nodes.size() > 1) {
+         auto tampered = m;
+         tampered.active_nodes.front() = leaf(1000);
+         REQUIRE(!tampered.valid());
+      }
+   }
+}
+
+TEST_CASE(heavy_proof_links_bft_blocks_to_the_proven_block) {
+   auto c = testing::paired_chain(20, producers);
+   auto config = make_config(c);
+
+   auto proof = c.heavy_proof(7);
+   REQUIRE(proof.bftproof.size() == 2);
+   REQUIRE(result_of(proofcheck::check_block_proof(config, proof)) == "");
+
+   REQUIRE(result_of(proofcheck::check_heavy_proof(config, proof, c.action_proof(7, 0))) == "");
+}
+
+TEST_CASE(heavy_proof_rejects_broken_merkle_links) {
+   auto c = testing::paired_chain(20, producers);
+   auto config = make_config(c);
+   auto proof = c.heavy_proof(9);
+
+   auto unlinked = proof;
+   unlinked.bftproof[0].bmproofpath.pop_back();
+   REQUIRE(result_of(proofcheck::check_block_proof(config, unlinked)) == "bft block does not confirm the proven block");
+
+   auto out_of_range = proof;
+   out_of_range.bftproof[1].bmproofpath[0] = uint16_t(proof.hashes.size());
+   REQUIRE(result_of(proofcheck::check_block_proof(config, out_of_range)) == "invalid bft merkle path node");
+
+   auto bad_active = proof;
+   bad_active.blocktoprove.active_nodes.push_back(uint16_t(proof.hashes.size()));
+   REQUIRE(result_of(proofcheck::check_block_proof(config, bad_active)) == "invalid active node");
+
+   auto bad_count = proof;
+   bad_count.blocktoprove.node_count++;
+   REQUIRE(result_of(proofcheck::check_block_proof(config, bad_count)) == "invalid incremental merkle");
+
+   auto reordered = proof;
+   std::swap(reordered.bftproof[0], reordered.bftproof[1]);
+   REQUIRE(result_of(proofcheck::check_block_proof(config, reordered)) == "bft proof blocks must be in ascending order");
+
+   auto short_bft = proof;
+   short_bft.bftproof.pop_back();
+   REQUIRE(result_of(proofcheck::check_block_proof(config, short_bft)) == "not enough producers confirming block");
+}
+
+TEST_CASE(proofs_follow_schedule_changes) {
+   auto c = testing::paired_chain(4, producers);
+   c.set_producers({ "prod.e"_n, "prod.f"_n, "prod.g"_n });
+   uint32_t announcing = c.produce_block();
+   for (uint32_t n = 0; n < 12; n++) c.produce_block();
+
+   chainfixture::mock_bridge bridge(c);
+
+   // a block signed over the pending schedule cannot be verified before the announcement is proven
+   REQUIRE(result_of(bridge.checkproofd(c.heavy_proof(announcing + 1))) == "insufficient producer signature weight");
+
+   REQUIRE(result_of(bridge.checkproofd(c.heavy_proof(announcing))) == "");
+   REQUIRE(result_of(bridge.checkproofd(c.heavy_proof(announcing + 1))) == "");
+
+   // the last block of the old schedule, confirmed by blocks of the new one
+   uint32_t last_old = announcing + uint32_t(producers.size());
+   auto crossing = c.heavy_proof(last_old);
+   REQUIRE(crossing.bftproof.back().header.schedule_version == 1);
+   REQUIRE(result_of(bridge.checkproofd(crossing)) == "");
+
+   REQUIRE(result_of(bridge.checkproofd(c.heavy_proof(c.head_block_num() - 3))) == "");
+}
+
+TEST_CASE(schedule_announced_through_new_producers) {
+   bridgetypes::blockheader header;
+   header.new_producers = producer_schedule{ 3, { producer_key{ "prod.a"_n, chainfixture::test_key("prod.a"_n) } } };
+
+   auto s = proofcheck::announced_schedule(header);
+   REQUIRE(s && s->version == 3 && s->producers.size() == 1);
+   REQUIRE(s->hash == proofcheck::hash_of(*header.new_producers));
+
+   const auto& auth = std::get<block_signing_authority_v0>(s->producers[0].authority);
+   REQUIRE(auth.threshold == 1 && auth.keys.size() == 1 && auth.keys[0].weight == 1);
+   REQUIRE(auth.keys[0].key == chainfixture::test_key("prod.a"_n));
+}
+
+TEST_CASE(verify_batch_reports_malformed_proofs) {
+   auto c = testing::paired_chain(12, producers);
+   auto config = make_config(c);
+
+   auto malformed = c.heavy_proof(3);
+   malformed.blocktoprove.block.header.header_extensions.push_back({ proofcheck::SCHEDULE_CHANGE_EXTENSION, { 1, 2, 3 } });
+
+   std::vector<proofcheck::job> jobs = {
+      { c.heavy_proof(2), c.action_proof(2, 0) },
+      { malformed, c.action_proof(3, 0) },
+      { c.light_proof(4, 8), c.action_proof(4, 0) },
+   };
+   config.proven_roots.insert(std::get<bridgetypes::lightproof>(jobs[2].blockproof).root);
+
+   auto results = proofcheck::verify_batch(config, jobs, 2);
+   REQUIRE(result_of(results[0]) == "");
+   REQUIRE(result_of(results[1]) == "proof verification threw");
+   REQUIRE(result_of(results[2]) == "");
+}
+
+// the bridge runs `checkproofb` / `checkproofe` through one implementation, and `checkproofc` / `checkprooff` through
+// another: both pairs include the return value in the action digest from the activation block on
+TEST_CASE(checkproofb_and_checkproofc_agree_with_checkproofe_and_checkprooff) {
+   chainfixture::chain c(chain_id, producers, 6);
+   for (uint32_t n = 1; n <= 12; n++) {
+      c.push_action(chainfixture::emitxfer("wraptoken"_n, "alice"_n, extended_asset(asset(n, symbol("EOS", 4)), "eosio.token"_n), "bob"_n), { char(n) });
+      c.produce_block();
+   }
+   chainfixture::mock_bridge bridge(c);
+   REQUIRE(result_of(bridge.checkproofd(c.heavy_proof(8))) == "");
+
+   for (uint32_t n : { 3, 7 }) {
+      auto action = c.action_proof(n, 0);
+      auto tampered = action;
+      tampered.returnvalue = { char(100) };
+      std::string expected = n < 6 ? "" : "action digest does not match receipt";
+
+      REQUIRE(result_of(bridge.checkproofb(c.heavy_proof(n), action)) == "");
+      REQUIRE(result_of(bridge.checkproofe(c.heavy_proof(n), action)) == "");
+      REQUIRE(result_of(bridge.checkproofb(c.heavy_proof(n), tampered)) == expected);
+      REQUIRE(result_of(bridge.checkproofe(c.heavy_proof(n), tampered)) == expected);
+
+      // light proofs against the root recorded for block 8
+      REQUIRE(result_of(bridge.checkproofc(c.light_proof(n, 8), action)) == "");
+      REQUIRE(result_of(bridge.checkprooff(c.light_proof(n, 8), action)) == "");
+      REQUIRE(result_of(bridge.checkproofc(c.light_proof(n, 8), tampered)) == expected);
+      REQUIRE(result_of(bridge.checkprooff(c.light_proof(n, 8), tampered)) == expected);
+   }
+}
@@ -0,0 +1,162 @@
+#include <wraplock_tester.hpp>
+
+#include <testing.hpp>
+
+using namespace eosio;
+
+namespace {
+
+   bridgetypes::actionproof make_actionproof() {
+      auto c = testing::paired_chain();
+      testing::retire(c, "alice"_n, 10000, "bob"_n);
+      testing::retire(c, "carol"_n, 20000, "dave"_n);
+      return c.action_proof(c.produce_block(), 1);
+   }
+
+   void append(std::vector<char>& out, const std::vector<char>& bytes) { out.insert(out.end(), bytes.begin(), bytes.end()); }
+
+   // receipt with code_sequence 1 encoded on three bytes, which the varint decoder accepts
+   std::vector<char> padded_receipt(const bridgetypes::actreceipt& r) {
+      std::vector<char> receipt = pack(std::make_tuple(r.receiver, r.act_digest, r.global_sequence, r.recv_sequence, r.auth_sequence));
+      append(receipt, { char(0x81), char(0x80), char(0x00) });
+      append(receipt, pack(r.abi_sequence));
+      return receipt;
+   }
+
+   // replay protection key of `withdrawa` / `withdrawb` / `cancela` / `cancelb`, from their raw action proof
+   checksum256 single_key(const std::vector<char>& actionproof) {
+      action act;
+      checksum256 digest;
+      datastream<const char*> ds(actionproof.data(), actionproof.size());
+      proofstream::read_actionproof(ds, act, digest);
+      REQUIRE(ds.valid() && ds.remaining() == 0);
+      return digest;
+   }
+
+   // replay protection key of `withdrawm`, from its raw `actions` argument
+   std::vector<checksum256> multi_keys(const std::vector<char>& actions) {
+      std::vector<checksum256> keys;
+      for (const auto& a : unpack<std::vector<wraplock::multiaction>>(actions)) keys.push_back(proofcheck::receipt_digest(a.receipt));
+      return keys;
+   }
+
+}
+
+TEST_CASE(read_actionproof_digests_the_canonical_receipt) {
+   auto proof = make_actionproof();
+   auto packed = pack(proof);
+
+   action act;
+   checksum256 digest;
+   datastream<const char*> ds(packed.data(), packed.size());
+   proofstream::read_actionproof(ds, act, digest);
+   REQUIRE(ds.valid() && ds.remaining() == 0);
+   REQUIRE(act.data == proof.action.data && act.name == proof.action.name);
+   REQUIRE(digest == proofcheck::receipt_digest(proof.receipt));
+}
+
+TEST_CASE(padded_varints_in_the_receipt_keep_its_digest) {
+   auto proof = make_actionproof();
+   const auto& r = proof.receipt;
+   REQUIRE(r.code_sequence.value == 1);
+
+   std::vector<char> receipt = padded_receipt(r);
+
+   std::vector<char> padded = pack(proof.action);
+   append(padded, receipt);
+   append(padded, pack(proof.returnvalue));
+   append(padded, pack(proof.amproofpath));
+
+   auto decoded = unpack<bridgetypes::actionproof>(padded);
+   REQUIRE(decoded.receipt.code_sequence.value == 1);
+   REQUIRE(proofcheck::hash(receipt.data(), receipt.size()) != proofcheck::receipt_digest(r));
+
+   action act;
+   checksum256 digest;
+   datastream<const char*> ds(padded.data(), padded.size());
+   proofstream::read_actionproof(ds, act, digest);
+   REQUIRE(ds.valid() && ds.remaining() == 0);
+   REQUIRE(digest == proofcheck::receipt_digest(r));
+}
+
+TEST_CASE(skip_vector_rejects_lengths_past_the_end) {
+   // 2^27 checksums are 2^32 bytes, a skip size that wraps to 0 in 32 bit (wasm) builds
+   std::vector<char> data = pack(unsigned_int(uint32_t(1) << 27));
+   data.resize(data.size() + 64);
+
+   datastream<const char*> ds(data.data(), data.size());
+   proofstream::skip_vector(ds, 32);
+   REQUIRE(!ds.valid());
+   proofstream::skip_vector(ds, 32);
+   REQUIRE(!ds.valid());
+
+   std::vector<char> exact = pack(std::vector<checksum256>(2));
+   datastream<const char*> ok(exact.data(), exact.size());
+   proofstream::skip_vector(ok, 32);
+   REQUIRE(ok.valid() && ok.remaining() == 0);
+}
+
+TEST_CASE(single_and_multi_action_withdrawals_share_their_replay_key) {
+   auto c = testing::paired_chain();
+   testing::retire(c, "alice"_n, 10000, "bob"_n);
+   testing::retire(c, "carol"_n, 20000, "dave"_n);
+   uint32_t block = c.produce_block();
+   auto [proofs, multiproof] = c.action_multiproof(block, { 0, 1 });
+
+   // every encoding of the same receipt, canonical or padded, through either entry point
+   std::vector<char> padded_single = pack(proofs[0].action);
+   append(padded_single, padded_receipt(proofs[0].receipt));
+   append(padded_single, pack(proofs[0].returnvalue));
+   append(padded_single, pack(c.action_proof(block, 0).amproofpath));
+
+   std::vector<char> padded_multi = pack(unsigned_int(2));
+   for (const auto& p : proofs) {
+      append(padded_multi, pack(p.action));
+      append(padded_multi, padded_receipt(p.receipt));
+      append(padded_multi, pack(p.returnvalue));
+      append(padded_multi, pack(std::make_pair(std::optional<accumulator::nonmembership_witness>(), std::optional<accumulator::nonmembership_witness>())));
+   }
+
+   std::vector<wraplock::multiaction> canonical;
+   for (const auto& p : proofs) canonical.push_back({ p.action, p.receipt, p.returnvalue, {}, {} });
+
+   REQUIRE(padded_multi != pack(canonical));
+
+   auto first = single_key(pack(c.action_proof(block, 0)));
+   REQUIRE(single_key(padded_single) == first);
+   REQUIRE(multi_keys(pack(canonical)) == multi_keys(padded_multi));
+   REQUIRE(multi_keys(padded_multi)[0] == first);
+
+   // the contract refuses a withdrawm after a withdrawa of one of its actions, and the reverse, whatever the encoding
+   testing::retire(c, "alice"_n, 10000, "bob"_n);
+   testing::retire(c, "carol"_n, 20000, "dave"_n);
+   uint32_t next = c.produce_block();
+
+   wraplocktest::tester t(c, { "alice"_n, "bob"_n, "carol"_n, "dave"_n, "relayer"_n });
+   t.issue("alice"_n, asset(60000, wraplocktest::eos));
+   REQUIRE(t.transfer("alice"_n, t.self, asset(60000, wraplocktest::eos), "alice") == "");
+
+   auto withdrawa = [&](const uint32_t b, const std::vector<char>& actionproof) {
+      std::vector<char> data = pack(std::make_tuple("relayer"_n, c.heavy_proof(b)));
+      append(data, actionproof);
+      return t.push(t.self, "withdrawa"_n, { "relayer"_n }, data);
+   };
+   auto withdrawm = [&](const uint32_t b, const std::vector<char>& actions) {
+      std::vector<char> data = pack(std::make_tuple("relayer"_n, c.heavy_proof(b)));
+      append(data, actions);
+      append(data, pack(c.action_multiproof(b, { 0, 1 }).second));
+      return t.push(t.self, "withdrawm"_n, { "relayer"_n }, data);
+   };
+
+   REQUIRE(withdrawa(block, padded_single) == "");
+   REQUIRE(withdrawa(block, pack(c.action_proof(block, 0))) == "action already proved");
+   REQUIRE(withdrawm(block, padded_multi) == "action already proved");
+   REQUIRE(withdrawm(block, pack(canonical)) == "action already proved");
+   REQUIRE(t.balance("bob"_n) == 10000 && t.balance("dave"_n) == 0);
+
+   std::vector<wraplock::multiaction> both;
+   for (const auto& p : c.action_multiproof(next, { 0, 1 }).first) both.push_back({ p.action, p.receipt, p.returnvalue, {}, {} });
+   REQUIRE(withdrawm(next, pack(both)) == "");
+   REQUIRE(withdrawa(next, pack(c.action_proof(next, 1))) == "action already proved");
+   REQUIRE(t.balance("bob"_n) == 20000 && t.balance("dave"_n) == 20000);
+}
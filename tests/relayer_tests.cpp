@@ -0,0 +1,245 @@
+#include <chainfixture.hpp>
+#include <relayer.hpp>
+
+#include <testing.hpp>
+
+using namespace eosio;
+
+namespace {
+
+   const permission_level relayer_auth{ "relayer"_n, "active"_n };
+
+   // `count` light withdrawals, one per block, small enough to share a transaction under the default budget
+   std::vector<relayer::ready_proof> make_proofs(const uint32_t count) {
+      auto c = testing::paired_chain(count);
+      std::vector<relayer::ready_proof> proofs;
+      for (uint32_t n = 1; n <= count; n++) proofs.push_back({ "withdrawb"_n, "relayer"_n, c.light_proof(n, count), c.action_proof(n, 0), std::nullopt, std::nullopt });
+      return proofs;
+   }
+
+   std::vector<signature> no_signature(const checksum256&) { return {}; }
+
+   // budget fitting a single light withdrawal per transaction
+   relayer::budget one_per_transaction() {
+      relayer::budget limits;
+      limits.cpu_us = 1;
+      return limits;
+   }
+
+}
+
+TEST_CASE(max_cpu_usage_applies_the_margin_and_caps_at_255_ms) {
+   relayer::cost_model costs;
+   REQUIRE(costs.max_cpu_usage_ms(2000) == 3);
+   REQUIRE(costs.max_cpu_usage_ms(2100) == 4);
+   REQUIRE(costs.max_cpu_usage_ms(400000) == 255);
+
+   costs.margin = 1;
+   REQUIRE(costs.max_cpu_usage_ms(2000) == 2);
+}
+
+TEST_CASE(calibrate_fits_per_action_and_per_byte_costs_from_transactions) {
+   relayer::cost_model costs;
+   std::vector<relayer::cost_model::sample> samples;
+   for (size_t actions = 1; actions <= 4; actions++) {
+      size_t bytes = actions * 700 + (actions % 2) * 90;
+      samples.push_back({ actions, bytes, 800.0 * actions + 0.25 * bytes });
+   }
+   costs.calibrate(false, samples);
+
+   REQUIRE(std::abs(costs.light.base_us - 800) < 1e-6);
+   REQUIRE(std::abs(costs.light.per_byte_us - 0.25) < 1e-9);
+   REQUIRE(costs.heavy.base_us == relayer::cost_model().heavy.base_us);
+
+   // samples of a single shape cannot separate the two costs, the model is left as is
+   relayer::cost_model unchanged;
+   unchanged.calibrate(false, { { 1, 700, 975 }, { 2, 1400, 1950 } });
+   REQUIRE(unchanged.light.base_us == relayer::cost_model().light.base_us);
+}
+
+TEST_CASE(rejected_single_actions_are_signed_again_and_retried) {
+   std::atomic<size_t> pushes{0};
+   std::atomic<size_t> signatures{0};
+   relayer::mock_endpoint chain(proofcheck::hash("local chain", 11), [&](const relayer::signed_trx&) {
+      return ++pushes == 1 ? relayer::push_result{ false, 0, "expired transaction" } : relayer::push_result{ true, 0, {} };
+   });
+   relayer::pipeline p(chain, [&](const checksum256& d) { signatures++; return no_signature(d); }, "wraplock"_n, relayer_auth);
+
+   auto r = p.run(make_proofs(1));
+   REQUIRE(r.transactions == 1 && r.actions == 1 && r.accepted == 1);
+   REQUIRE(r.batches.size() == 1);
+   REQUIRE(r.batches[0].accepted && r.batches[0].attempts == 2 && r.batches[0].error.empty());
+   REQUIRE(signatures == 2);
+   REQUIRE(chain.pushed().size() == 1 && chain.rejected().size() == 1);
+}
+
+TEST_CASE(rejected_batches_are_bisected_down_to_the_failing_proof) {
+   auto proofs = make_proofs(5);
+   auto poisoned = proofs[3].data();
+   relayer::mock_endpoint chain(proofcheck::hash("local chain", 11), [&](const relayer::signed_trx& trx) {
+      for (const auto& a : trx.trx.actions) if (a.data == poisoned) return relayer::push_result{ false, 0, "action already proved" };
+      return relayer::push_result{ true, 0, {} };
+   });
+   relayer::pipeline p(chain, no_signature, "wraplock"_n, relayer_auth);
+   p.max_attempts = 2;
+
+   auto r = p.run(proofs);
+   REQUIRE(r.actions == 5 && r.failed == std::vector<size_t>{ 3 });
+
+   // halving 0-4 until proof 3 is alone, which is retried before it is dropped
+   REQUIRE(r.batches.size() == 7 && r.transactions == 7 && r.accepted == 3);
+   REQUIRE(r.batches[0].split && r.batches[0].proofs == (std::vector<size_t>{ 0, 1, 2, 3, 4 }));
+   REQUIRE(r.batches[1].accepted && r.batches[1].proofs == (std::vector<size_t>{ 0, 1 }));
+   REQUIRE(r.batches[2].split && r.batches[2].proofs == (std::vector<size_t>{ 2, 3, 4 }));
+   REQUIRE(r.batches[3].accepted && r.batches[3].proofs == std::vector<size_t>{ 2 });
+   REQUIRE(r.batches[4].split && r.batches[4].proofs == (std::vector<size_t>{ 3, 4 }));
+   REQUIRE(!r.batches[5].accepted && r.batches[5].proofs == std::vector<size_t>{ 3 });
+   REQUIRE(r.batches[5].attempts == 2 && r.batches[5].error == "action already proved");
+   REQUIRE(r.batches[6].accepted && r.batches[6].proofs == std::vector<size_t>{ 4 });
+   REQUIRE(chain.pushed().size() == 3);
+
+   size_t accepted_actions = 0;
+   for (const auto& trx : chain.pushed()) accepted_actions += trx.trx.actions.size();
+   REQUIRE(accepted_actions == 4);
+}
+
+TEST_CASE(batches_out_of_attempts_are_reported_with_their_error) {
+   relayer::mock_endpoint chain(proofcheck::hash("local chain", 11), [](const relayer::signed_trx&) {
+      return relayer::push_result{ false, 0, "deadline exceeded" };
+   });
+   relayer::pipeline p(chain, no_signature, "wraplock"_n, relayer_auth, {}, one_per_transaction());
+   p.max_attempts = 2;
+
+   auto r = p.run(make_proofs(2));
+   REQUIRE(r.transactions == 2 && r.accepted == 0);
+   for (const auto& b : r.batches) REQUIRE(!b.accepted && b.attempts == 2 && b.error == "deadline exceeded");
+   REQUIRE(chain.rejected().size() == 4);
+}
+
+TEST_CASE(signer_and_endpoint_exceptions_fail_the_attempt_only) {
+   std::atomic<size_t> signed_count{0};
+   relayer::pipeline::signer flaky = [&](const checksum256& d) -> std::vector<signature> {
+      if (signed_count++ == 0) throw std::runtime_error("key unavailable");
+      return no_signature(d);
+   };
+
+   std::atomic<size_t> pushes{0};
+   relayer::mock_endpoint chain(proofcheck::hash("local chain", 11), [&](const relayer::signed_trx&) -> relayer::push_result {
+      if (pushes++ == 0) throw std::runtime_error("connection reset");
+      return { true, 0, {} };
+   });
+
+   relayer::pipeline p(chain, flaky, "wraplock"_n, relayer_auth, {}, one_per_transaction(), 1);
+   p.max_attempts = 1;
+
+   auto r = p.run(make_proofs(3));
+   REQUIRE(r.transactions == 3 && r.accepted == 1);
+   REQUIRE(r.batches[0].error == "signing failed: key unavailable");
+   REQUIRE(r.batches[1].error == "push failed: connection reset");
+   REQUIRE(r.batches[2].accepted && r.batches[2].attempts == 1);
+
+   r = p.run(make_proofs(3));
+   REQUIRE(r.accepted == 3);
+}
+
+TEST_CASE(billed_cpu_calibrates_the_cost_model_and_the_declared_limit) {
+   relayer::cost_model initial;
+   relayer::mock_endpoint chain(proofcheck::hash("local chain", 11), [](const relayer::signed_trx& trx) {
+      size_t bytes = 0;
+      for (const auto& a : trx.trx.actions) bytes += a.data.size();
+      return relayer::push_result{ true, uint32_t(1000 * trx.trx.actions.size() + bytes / 2), {} };
+   });
+   relayer::pipeline p(chain, no_signature, "wraplock"_n, relayer_auth, initial);
+
+   // transactions of one and two actions, a single sample is not enough to calibrate
+   p.run(make_proofs(1));
+   REQUIRE(p.costs().light.base_us == initial.light.base_us);
+   p.run(make_proofs(2));
+   REQUIRE(p.costs().light.base_us != initial.light.base_us);
+
+   size_t bytes = make_proofs(3)[0].data().size();
+   REQUIRE(std::abs(p.costs().cpu_us(false, bytes) - (1000 + bytes / 2.0)) < 2);
+
+   auto r = p.run(make_proofs(1));
+   REQUIRE(r.accepted == 1);
+   auto last = chain.pushed().back();
+   REQUIRE(last.trx.max_cpu_usage_ms == p.costs().max_cpu_usage_ms(p.costs().cpu_us(false, last.trx.actions[0].data.size())));
+}
+
+TEST_CASE(pack_batches_groups_by_block_then_heavy_before_light) {
+   auto c = testing::paired_chain();
+   for (uint32_t n = 1; n <= 3; n++) {
+      testing::retire(c, "alice"_n, n, "bob"_n);
+      testing::retire(c, "carol"_n, n, "bob"_n);
+      c.produce_block();
+   }
+   auto heavy = [&](const uint32_t n, const uint32_t i) { return relayer::ready_proof{ "withdrawa"_n, "relayer"_n, c.heavy_proof(n), c.action_proof(n, i), std::nullopt, std::nullopt }; };
+   auto light = [&](const uint32_t n, const uint32_t i) { return relayer::ready_proof{ "withdrawb"_n, "relayer"_n, c.light_proof(n, 3), c.action_proof(n, i), std::nullopt, std::nullopt }; };
+
+   std::vector<relayer::ready_proof> proofs = { light(3, 0), heavy(2, 1), light(1, 0), heavy(3, 1), light(2, 0), heavy(1, 1), light(1, 1) };
+
+   relayer::cost_model costs;
+   relayer::budget unlimited;
+   unlimited.cpu_us = 1e9;
+   unlimited.net_bytes = 1 << 30;
+   auto batches = relayer::pack_batches(proofs, "wraplock"_n, relayer_auth, costs, unlimited);
+   REQUIRE(batches.size() == 1);
+   REQUIRE(batches[0].proofs == (std::vector<size_t>{ 5, 2, 6, 1, 4, 3, 0 }));
+   REQUIRE(batches[0].heavy_actions == 3 && batches[0].actions.size() == 7);
+   for (size_t k = 0; k < 7; k++) REQUIRE(batches[0].actions[k].data == proofs[batches[0].proofs[k]].data());
+
+   // with room for two actions per transaction the same order is cut in consecutive runs
+   relayer::budget two_heavy = unlimited;
+   two_heavy.cpu_us = 2 * costs.cpu_us(true, proofs[5].data().size()) + 1;
+   batches = relayer::pack_batches(proofs, "wraplock"_n, relayer_auth, costs, two_heavy);
+   std::vector<size_t> order;
+   for (const auto& b : batches) {
+      REQUIRE(b.cpu_us <= two_heavy.cpu_us);
+      order.insert(order.end(), b.proofs.begin(), b.proofs.end());
+   }
+   REQUIRE(order == (std::vector<size_t>{ 5, 2, 6, 1, 4, 3, 0 }));
+}
+
+TEST_CASE(pack_batches_splits_on_the_net_budget) {
+   auto proofs = make_proofs(7);
+   relayer::cost_model costs;
+   size_t net = costs.net_bytes(proofs[0].data().size());
+   for (const auto& p : proofs) REQUIRE(costs.net_bytes(p.data().size()) == net);
+
+   // cpu is no constraint, the NET budget fits three actions and the transaction overhead
+   relayer::budget limits;
+   limits.cpu_us = 1e9;
+   limits.net_bytes = costs.transaction_overhead_bytes + 3 * net;
+   auto batches = relayer::pack_batches(proofs, "wraplock"_n, relayer_auth, costs, limits);
+   REQUIRE(batches.size() == 3);
+   REQUIRE(batches[0].actions.size() == 3 && batches[1].actions.size() == 3 && batches[2].actions.size() == 1);
+   for (const auto& b : batches) REQUIRE(b.net_bytes == costs.transaction_overhead_bytes + b.actions.size() * net && b.net_bytes <= limits.net_bytes);
+
+   // one byte less and only two fit
+   limits.net_bytes--;
+   REQUIRE(relayer::pack_batches(proofs, "wraplock"_n, relayer_auth, costs, limits).size() == 4);
+
+   // an action above the budget still gets a transaction of its own
+   limits.net_bytes = net;
+   batches = relayer::pack_batches(proofs, "wraplock"_n, relayer_auth, costs, limits);
+   REQUIRE(batches.size() == 7);
+   for (const auto& b : batches) REQUIRE(b.actions.size() == 1);
+}
+
+TEST_CASE(witnesses_are_appended_to_the_action_data_when_present) {
+   auto proof = make_proofs(1)[0];
+   auto plain = proof.data();
+
+   std::vector<checksum256> leaves = { proofcheck::hash_of(uint32_t(1)), proofcheck::hash_of(uint32_t(2)) };
+   std::sort(leaves.begin(), leaves.end());
+   accumulator::nonmembership_witness w{ 0, accumulator::prove(leaves, 0), std::nullopt };
+
+   // the legacy witness alone, after a null epoch witness
+   proof.legacy_witness = w;
+   auto with_legacy = proof.data();
+   REQUIRE(std::equal(plain.begin(), plain.end(), with_legacy.begin()));
+   datastream<const char*> ds(with_legacy.data() + plain.size(), with_legacy.size() - plain.size());
+   std::optional<accumulator::nonmembership_witness> witness, legacy_witness;
+   ds >> witness >> legacy_witness;
+   REQUIRE(ds.remaining() == 0 && !witness && legacy_witness && legacy_witness->hi.leaf == leaves[0]);
+}
@@ -0,0 +1,162 @@
+#include <map>
+
+#include <snapshot.hpp>
+#include <snapshotexport.hpp>
+
+#include <testing.hpp>
+
+using namespace eosio;
+
+namespace {
+
+   // rows are byte vectors, packed with their length like any variable size row
+   using row_bytes = std::vector<char>;
+
+   // rows of a contract, by table then scope
+   using tables = std::map<name, std::map<uint64_t, std::vector<row_bytes>>>;
+
+   row_bytes make_row(const uint64_t id, const size_t size) {
+      row_bytes r = pack(id);
+      r.resize(size, char(id));
+      return r;
+   }
+
+   tables read_all(const char* path, const name& contract) {
+      snapshot::reader r(path);
+      REQUIRE(r.header().contract == contract);
+
+      tables out;
+      while (auto c = r.next()) {
+         auto& rows = out[c->header.table][c->header.scope];
+         snapshot::reader::for_each_row<row_bytes>(*c, [&](const row_bytes& row) { rows.push_back(row); });
+      }
+      return out;
+   }
+
+   std::string hex(const row_bytes& bytes) {
+      static const char digits[] = "0123456789abcdef";
+      std::string out;
+      for (char c : bytes) { out += digits[uint8_t(c) >> 4]; out += digits[uint8_t(c) & 15]; }
+      return out;
+   }
+
+   // answers get_table_by_scope / get_table_rows from `contents`, `page` entries at a time
+   snapshot::rpc fake_node(const tables& contents, const size_t page, size_t& requests) {
+      return [&contents, page, &requests](const std::string& path, const std::string& body) -> std::string {
+         requests++;
+         auto request = snapshot::json::parse(body);
+         name table(request["table"].text);
+         std::string lower_bound = request["lower_bound"].text;
+         REQUIRE(request["code"].text == "wraplock" && std::stoul(request["limit"].text) == page);
+
+         auto t = contents.find(table);
+         if (path == "/v1/chain/get_table_by_scope") {
+            std::vector<uint64_t> scopes;
+            if (t != contents.end()) for (const auto& [scope, rows] : t->second) scopes.push_back(scope);
+            size_t start = 0;
+            while (!lower_bound.empty() && start < scopes.size() && scopes[start] < name(lower_bound).value) start++;
+
+            std::string rows;
+            for (size_t i = start; i < scopes.size() && i < start + page; i++) {
+               rows += std::string(rows.empty() ? "" : ",") + "{\"code\":\"wraplock\",\"scope\":" + snapshot::json::quote(name(scopes[i]).to_string()) +
+                       ",\"table\":" + snapshot::json::quote(table.to_string()) + ",\"payer\":\"wraplock\",\"count\":1}";
+            }
+            std::string more = start + page < scopes.size() ? name(scopes[start + page]).to_string() : "";
+            return "{\"rows\":[" + rows + "],\"more\":" + snapshot::json::quote(more) + "}";
+         }
+
+         REQUIRE(path == "/v1/chain/get_table_rows");
+         REQUIRE(request["json"].kind == snapshot::json::value::boolean && !request["json"].flag);
+         const auto& rows = t->second.at(name(request["scope"].text).value);
+         size_t start = lower_bound.empty() ? 0 : std::stoul(lower_bound);
+
+         std::string out;
+         for (size_t i = start; i < rows.size() && i < start + page; i++) out += std::string(out.empty() ? "" : ",") + "\"" + hex(pack(rows[i])) + "\"";
+         bool more = start + page < rows.size();
+         return "{\"rows\":[" + out + "],\"more\":" + (more ? "true" : "false") + ",\"next_key\":\"" + (more ? std::to_string(start + page) : "") + "\"}";
+      };
+   }
+
+}
+
+TEST_CASE(snapshot_round_trips_rows_across_chunks) {
+   const char* path = "snapshot_round_trip.snap";
+   tables written;
+   {
+      snapshot::writer w(path, "wraplock"_n, 3, 100);
+      for (uint64_t i = 0; i < 7; i++) {
+         written["processed"_n][2800].push_back(make_row(i, 40));
+         w.row("processed"_n, 2800, written["processed"_n][2800].back());
+      }
+      written["reserves"_n]["eosio.token"_n.value].push_back(make_row(9, 16));
+      w.row("reserves"_n, "eosio.token"_n.value, written["reserves"_n]["eosio.token"_n.value].back());
+      w.close();
+   }
+
+   snapshot::reader r(path);
+   std::vector<uint32_t> chunk_rows;
+   while (auto c = r.next()) {
+      chunk_rows.push_back(c->header.row_count);
+      auto act = snapshot::import_action("wraplock"_n, *c);
+      REQUIRE(act.name == "importrows"_n && act.data.size() == 8 + 8 + pack(unsigned_int(c->header.byte_size)).size() + c->header.byte_size);
+   }
+   // rows of 41 bytes: at most 100 bytes per chunk, a new chunk per table
+   REQUIRE((chunk_rows == std::vector<uint32_t>{ 2, 2, 2, 1, 1 }));
+
+   REQUIRE(read_all(path, "wraplock"_n) == written);
+   std::remove(path);
+}
+
+TEST_CASE(unclosed_snapshot_is_rejected) {
+   const char* path = "snapshot_unclosed.snap";
+   {
+      snapshot::writer w(path, "wraplock"_n);
+      w.row("processed"_n, 1, make_row(1, 40));
+   }
+
+   bool rejected = false;
+   try {
+      snapshot::reader r(path);
+      while (r.next()) {}
+   }
+   catch (const std::runtime_error&) {
+      rejected = true;
+   }
+   REQUIRE(rejected);
+   std::remove(path);
+}
+
+TEST_CASE(json_parser_reads_chain_api_responses) {
+   auto v = snapshot::json::parse(" {\"rows\": [\"00ff\", {\"a\": [1, -2.5e3, true, false, null]}], \"more\": \"x\\\"\\\\\\n\\u00e9\" } ");
+   REQUIRE(v.kind == snapshot::json::value::object);
+   REQUIRE(v["rows"].items.size() == 2 && v["rows"].items[0].text == "00ff");
+
+   const auto& a = v["rows"].items[1]["a"];
+   REQUIRE(a.items.size() == 5 && a.items[1].kind == snapshot::json::value::number && a.items[1].text == "-2.5e3");
+   REQUIRE(a.items[2].flag && a.items[3].kind == snapshot::json::value::boolean && !a.items[3].flag && a.items[4].kind == snapshot::json::value::null);
+   REQUIRE(v["more"].text == "x\"\\\n\xc3\xa9");
+   REQUIRE(v["missing"].kind == snapshot::json::value::null);
+
+   REQUIRE(snapshot::json::parse(snapshot::json::quote(v["more"].text)).text == v["more"].text);
+}
+
+TEST_CASE(exporter_pages_through_scopes_and_rows) {
+   tables contents;
+   contents["global"_n]["wraplock"_n.value] = { make_row(1, 90) };
+   for (uint64_t epoch = 2800; epoch < 2805; epoch++) {
+      for (uint64_t i = 0; i < 5 + epoch % 3; i++) contents["processed"_n][epoch].push_back(make_row(epoch * 100 + i, 40));
+   }
+   contents["reserves"_n]["eosio.token"_n.value] = { make_row(7, 16), make_row(8, 16) };
+
+   size_t requests = 0;
+   const char* path = "snapshot_export.snap";
+   {
+      snapshot::writer w(path, "wraplock"_n);
+      snapshot::exporter e(fake_node(contents, 2, requests), "wraplock"_n, 2);
+      REQUIRE(e.run(w) == 1 + 6 + 7 + 5 + 6 + 7 + 2);
+      w.close();
+   }
+   REQUIRE(requests > 20);
+   REQUIRE(read_all(path, "wraplock"_n) == contents);
+   std::remove(path);
+}
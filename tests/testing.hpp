@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <chainfixture.hpp>
+
+// Minimal test registry: `TEST_CASE(name) { ... }` registers a case, `REQUIRE(condition)` fails it, and main runs
+// every registered case of the executable, reporting each one. `paired_chain` and `retire` build the fixture chain
+// the tests prove against.
+
+namespace testing {
+
+   struct test_case {
+      const char*    name;
+      void           (*run)();
+   };
+
+   inline std::vector<test_case>& registry() {
+      static std::vector<test_case> cases;
+      return cases;
+   }
+
+   struct registrar {
+      registrar(const char* name, void (*run)()) { registry().push_back({ name, run }); }
+   };
+
+   struct failure : std::runtime_error {
+      using std::runtime_error::runtime_error;
+   };
+
+   inline int run_all() {
+      size_t failed = 0;
+      for (const auto& t : registry()) {
+         try {
+            t.run();
+            std::printf("pass %s\n", t.name);
+         }
+         catch (const std::exception& e) {
+            failed++;
+            std::printf("FAIL %s: %s\n", t.name, e.what());
+         }
+      }
+      std::printf("%zu of %zu failed\n", failed, registry().size());
+      return failed ? 1 : 0;
+   }
+
+   // an xfer emitted by wraptoken on the paired chain, retiring `amount` EOS of `owner` to `beneficiary`
+   inline void retire(chainfixture::chain& c, const eosio::name& owner, const int64_t amount, const eosio::name& beneficiary) {
+      c.push_action(chainfixture::emitxfer(eosio::name("wraptoken"), owner, eosio::extended_asset(eosio::asset(amount, eosio::symbol("EOS", 4)), eosio::name("eosio.token")), beneficiary));
+   }
+
+   // the paired chain of wraplock, signed by `producers`; block n of the first `blocks` retires n EOS of alice to bob
+   inline chainfixture::chain paired_chain(const uint32_t blocks = 0, const std::vector<eosio::name>& producers = { eosio::name("prod.a") }) {
+      chainfixture::chain c(proofcheck::hash("paired chain", 12), producers);
+      for (uint32_t n = 1; n <= blocks; n++) {
+         retire(c, eosio::name("alice"), n, eosio::name("bob"));
+         c.produce_block();
+      }
+      return c;
+   }
+
+}
+
+#define TEST_CASE(name) \
+   static void name(); \
+   static testing::registrar name##_registrar(#name, name); \
+   static void name()
+
+#define REQUIRE(condition) \
+   do { if (!(condition)) throw testing::failure(std::string(__FILE__ ":") + std::to_string(__LINE__) + ": " #condition); } while (0)
@@ -0,0 +1,52 @@
+#include <type_traits>
+
+#include <wraplock_tester.hpp>
+
+#include <testing.hpp>
+
+// the contract built with WRAPLOCK_LIGHT_PROOFS=0, see tests/CMakeLists.txt
+
+using namespace eosio;
+using wraplocktest::eos;
+
+static_assert(WRAPLOCK_HEAVY_PROOFS && !WRAPLOCK_LIGHT_PROOFS, "built as a heavy proof only contract");
+
+namespace {
+
+   template<typename T, typename = void>
+   struct has_proofadvice : std::false_type {};
+
+   template<typename T>
+   struct has_proofadvice<T, std::void_t<decltype(&T::proofadvice)>> : std::true_type {};
+
+   template<typename T, typename = void>
+   struct has_withdrawb : std::false_type {};
+
+   template<typename T>
+   struct has_withdrawb<T, std::void_t<decltype(&T::withdrawb)>> : std::true_type {};
+
+   // no light proof action is part of the contract, so none reaches its ABI
+   static_assert(!has_proofadvice<wraplock>::value && !has_withdrawb<wraplock>::value, "light proof actions compiled in");
+
+   const std::vector<name> users = { "alice"_n, "bob"_n, "relayer"_n };
+
+}
+
+TEST_CASE(heavy_only_contract_deposits_and_withdraws) {
+   auto paired = testing::paired_chain();
+   wraplocktest::tester t(paired, users);
+
+   t.issue("alice"_n, asset(5000, eos));
+   REQUIRE(t.transfer("alice"_n, t.self, asset(5000, eos), "bob") == "");
+   REQUIRE(t.emitted().size() == 1 && t.reserve() == 5000);
+
+   testing::retire(paired, "bob"_n, 2000, "alice"_n);
+   auto block = paired.produce_block();
+   REQUIRE(t.act("withdrawa"_n, "relayer"_n, "relayer"_n, paired.heavy_proof(block), paired.action_proof(block, 0)) == "");
+   REQUIRE(t.balance("alice"_n) == 2000 && t.reserve() == 3000);
+   REQUIRE(t.result<wraplock::opresult>().proof_type == "heavy"_n);
+
+   // light proof actions are not dispatched
+   REQUIRE(t.act("proofadvice"_n, "relayer"_n, block) == "unknown action");
+   REQUIRE(t.act("withdrawb"_n, "relayer"_n, "relayer"_n, paired.light_proof(block, block), paired.action_proof(block, 0)) == "unknown action");
+}
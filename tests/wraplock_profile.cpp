@@ -0,0 +1,58 @@
+#include <profiling.hpp>
+#include <wraplock_tester.hpp>
+
+#include <testing.hpp>
+
+// Deposit and withdrawal workload of the profiled contract (WRAPLOCK_PROFILING, see tests/CMakeLists.txt). The stage
+// totals are written as folded stacks, e.g. `flamegraph.pl wraplock.folded > wraplock.svg`.
+
+using namespace eosio;
+using wraplocktest::eos;
+
+namespace {
+
+   const std::vector<name> users = { "alice"_n, "bob"_n, "carol"_n, "relayer"_n };
+
+   constexpr uint32_t rounds = 50;
+
+   void write(const char* path, const profiling::collector::metric m) {
+      FILE* out = std::fopen(path, "w");
+      REQUIRE(out != nullptr);
+      profiling::collector::instance().write_folded(out, m);
+      std::fclose(out);
+   }
+
+}
+
+TEST_CASE(profile_deposits_and_withdrawals) {
+   auto paired = testing::paired_chain();
+   wraplocktest::tester t(paired, users);
+   t.issue("alice"_n, asset(rounds * 1000, eos));
+   profiling::collector::instance().reset();
+
+   for (uint32_t i = 0; i < rounds; i++) {
+      REQUIRE(t.transfer("alice"_n, t.self, asset(1000, eos), "bob") == "");
+
+      testing::retire(paired, "bob"_n, 1000, i % 2 ? "carol"_n : "bob"_n);
+      auto block = paired.produce_block();
+      REQUIRE(t.act("withdrawa"_n, "relayer"_n, "relayer"_n, paired.heavy_proof(block), paired.action_proof(block, 0)) == "");
+
+      // replays fail inside the stages, which are closed all the same
+      REQUIRE(t.act("withdrawa"_n, "relayer"_n, "relayer"_n, paired.heavy_proof(block), paired.action_proof(block, 0)) == "action already proved");
+      REQUIRE(profiling::collector::instance().depth() == 0);
+   }
+
+   auto totals = profiling::collector::instance().snapshot();
+   // wraplock is also notified of the transfers paying out withdrawals
+   REQUIRE(totals["deposit"].calls == rounds * 2);
+   REQUIRE(totals["deposit;reserves"].calls == rounds * 2);
+   REQUIRE(totals["deposit;inline_actions"].calls == rounds);
+   REQUIRE(totals["withdrawa"].calls == rounds * 2);
+   REQUIRE(totals["withdrawa;processed"].calls == rounds * 2);
+   REQUIRE(totals["withdrawa;bridge_handoff"].calls == rounds * 2);
+   REQUIRE(totals["withdrawa;inline_actions"].calls == rounds);
+   REQUIRE(totals["withdrawa;deserialize"].allocations > 0);
+
+   write("wraplock.folded", profiling::collector::metric::nanoseconds);
+   write("wraplock.alloc.folded", profiling::collector::metric::allocations);
+}
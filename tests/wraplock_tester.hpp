@@ -0,0 +1,291 @@
+#pragma once
+
+#include <functional>
+#include <map>
+
+#include <chainfixture.hpp>
+#include <wraplock.hpp>
+
+#include <host_chain.hpp>
+
+// Runs the wraplock contract of src/wraplock.cpp, built with the host compiler, on the host chain of
+// host_intrinsics.cpp. Actions reach the contract through the CDT dispatcher (`execute_action`) as on chain; the
+// notifications and inline actions they cause are applied after them, in the order the chain applies them:
+//
+// - `transfer` on a token contract: a minimal ledger notifying both parties like eosio.token, so deposits reach
+//   `wraplock::deposit` as a notification
+// - `checkproofd` / `checkproofe` / `checkprooff` on the bridge: a `chainfixture::mock_bridge` of the paired chain,
+//   whose `chains` and `lastproofs` rows the tester keeps on the host chain
+// - `emitxfer` on wraplock itself
+//
+// A failed transaction leaves the tables and the ledger as they were, `push` returns its error message.
+
+namespace wraplocktest {
+
+   using namespace eosio;
+
+   const symbol eos = symbol("EOS", 4);
+
+   // an action applied by the last transaction, with the return value it set
+   struct applied {
+      name                 receiver;
+      action               act;
+      std::vector<char>    return_value;
+   };
+
+   class tester {
+      public:
+         static constexpr name self = "wraplock"_n;
+         static constexpr name bridge_account = "bridge"_n;
+         static constexpr name token = "eosio.token"_n;
+         static constexpr name wraptoken = "wraptoken"_n;
+         static constexpr name paired_chain = "paired"_n;
+
+         // wraplock initialized against `paired`, `token` registered and the contract enabled
+         tester(const chainfixture::chain& paired, const std::vector<name>& users) : _bridge(paired) {
+            hostchain::current() = hostchain::state();
+            for (const auto& a : { self, bridge_account, token }) create_account(a);
+            for (const auto& a : users) create_account(a);
+            set_time(time_point_sec(1600000000 + 3600));
+
+            as(bridge_account, [&]() {
+               bridgetypes::chainstable chains( bridge_account, bridge_account.value );
+               chains.emplace( bridge_account, [&]( auto& c ) {
+                  c.name = paired_chain;
+                  c.chain_id = paired.chain_id();
+                  c.return_value_activated = paired.return_value_activated();
+               });
+            });
+
+            require(push(self, "init"_n, { self }, pack(std::make_tuple(checksum256(), bridge_account, paired.chain_id()))));
+            require(push(self, "addcontract"_n, { self }, pack(std::make_tuple(token, wraptoken))));
+            require(push(self, "enable"_n, { self }, {}));
+         }
+
+         void create_account(const name& account) { hostchain::current().accounts.insert(account.value); }
+
+         void set_time(const time_point_sec& t) { hostchain::current().now = uint64_t(t.sec_since_epoch()) * 1000000; }
+         time_point_sec now() const { return time_point_sec(uint32_t(hostchain::current().now / 1000000)); }
+
+         chainfixture::mock_bridge& bridge() { return _bridge; }
+
+         // a heavy proven block root of the paired chain stored by the bridge, as read by `proofadvice`
+         void store_proof(const uint64_t id, const uint32_t block_height, const checksum256& root, const time_point& expiry) {
+            as(bridge_account, [&]() {
+               bridgetypes::proofstable proofs( bridge_account, paired_chain.value );
+               proofs.emplace( bridge_account, [&]( auto& p ) {
+                  p.id = id;
+                  p.block_height = block_height;
+                  p.block_merkle_root = root;
+                  p.expiry = expiry;
+               });
+            });
+         }
+
+         // a receipt digest accepted before epochs were introduced, in the `processed` rows scoped by the contract
+         void add_legacy_digest(const checksum256& digest) {
+            as(self, [&]() {
+               wraplock::processedtable processed( self, self.value );
+               processed.emplace( self, [&]( auto& p ) {
+                  p.id = processed.available_primary_key();
+                  p.receipt_digest = digest;
+               });
+            });
+         }
+
+         void issue(const name& owner, const asset& quantity, const name& contract = token) { _balances[{ contract, owner, quantity.symbol }] += quantity.amount; }
+
+         int64_t balance(const name& owner, const symbol& sym = eos, const name& contract = token) const {
+            auto i = _balances.find({ contract, owner, sym });
+            return i == _balances.end() ? 0 : i->second;
+         }
+
+         // applies `account::act` as a transaction signed by `signers`, returns its error message or "" when applied
+         std::string push(const name& account, const name& act, const std::vector<name>& signers, const std::vector<char>& data) {
+            action a;
+            a.account = account;
+            a.name = act;
+            for (const auto& s : signers) a.authorization.push_back({ s, "active"_n });
+            a.data = data;
+
+            auto db = hostchain::current().db;
+            auto balances = _balances;
+            _applied.clear();
+            try {
+               apply(account, a, name());
+            }
+            catch (const std::exception& e) {
+               hostchain::current().db = std::move(db);
+               _balances = std::move(balances);
+               _applied.clear();
+               return e.what();
+            }
+            return "";
+         }
+
+         // a wraplock action signed by `signer`, with `args` as its data
+         template<typename... Args>
+         std::string act(const name& action_name, const name& signer, const Args&... args) {
+            return push(self, action_name, { signer }, pack(std::make_tuple(args...)));
+         }
+
+         std::string transfer(const name& from, const name& to, const asset& quantity, const std::string& memo, const name& contract = token) {
+            return push(contract, "transfer"_n, { from }, pack(std::make_tuple(from, to, quantity, memo)));
+         }
+
+         const std::vector<applied>& applied_actions() const { return _applied; }
+
+         // return value of the last transaction's first action applied by `receiver`
+         template<typename T>
+         T result(const name& receiver = self) const {
+            for (const auto& a : _applied) if (a.receiver == receiver && !a.return_value.empty()) return unpack<T>(a.return_value);
+            check(false, "no return value");
+            return T();
+         }
+
+         // xfers emitted by wraplock in the last transaction
+         std::vector<wraplock::xfer> emitted() const {
+            std::vector<wraplock::xfer> out;
+            for (const auto& a : _applied) if (a.receiver == self && a.act.name == "emitxfer"_n) out.push_back(unpack<wraplock::xfer>(a.act.data));
+            return out;
+         }
+
+         // reserve of a token held by wraplock: the `reserves` row and every shard of `resdeltas`
+         int64_t reserve(const symbol& sym = eos, const name& contract = token) const {
+            int64_t total = 0;
+            wraplock::reserves reserves( self, contract.value );
+            for (auto itr = reserves.begin(); itr != reserves.end(); itr++) if (itr->balance.symbol == sym) total += itr->balance.amount;
+            wraplock::reservedeltas deltas( self, contract.value );
+            for (auto itr = deltas.begin(); itr != deltas.end(); itr++) if (itr->delta.symbol == sym) total += itr->delta.amount;
+            return total;
+         }
+
+         static void require(const std::string& error) { if (!error.empty()) throw std::runtime_error(error); }
+
+      private:
+         void as(const name& receiver, const std::function<void()>& f) {
+            hostchain::action_context context;
+            context.receiver = receiver.value;
+            context.first_receiver = receiver.value;
+            hostchain::begin_action(context);
+            f();
+         }
+
+         void apply(const name& receiver, const action& a, const name& sender) {
+            hostchain::action_context context;
+            context.receiver = receiver.value;
+            context.first_receiver = a.account.value;
+            context.sender = sender.value;
+            context.data = a.data;
+            for (const auto& p : a.authorization) context.authorizers.insert(p.actor.value);
+            hostchain::begin_action(context);
+
+            std::vector<name> notified;
+            if (receiver == self) dispatch(a.account, a.name);
+            else if (receiver == bridge_account) check_proof(a);
+            else if (receiver == a.account && a.name == "transfer"_n) notified = transfer(a);
+            else check(false, "no contract to apply the action");
+
+            auto& c = hostchain::current().context;
+            _applied.push_back({ receiver, a, c.return_value });
+            std::vector<std::pair<name, std::vector<char>>> inline_actions;   // with their sender
+            for (const auto& packed : c.inline_actions) inline_actions.push_back({ receiver, packed });
+
+            // notifications, as transfers notify both parties, then the inline actions of the action and notifications
+            for (const auto& n : notified) {
+               if (n != self) continue;
+               hostchain::action_context notification;
+               notification.receiver = n.value;
+               notification.first_receiver = a.account.value;
+               notification.sender = receiver.value;
+               notification.data = a.data;
+               for (const auto& p : a.authorization) notification.authorizers.insert(p.actor.value);
+               hostchain::begin_action(notification);
+               dispatch(a.account, a.name);
+               auto& nc = hostchain::current().context;
+               _applied.push_back({ n, a, nc.return_value });
+               for (const auto& packed : nc.inline_actions) inline_actions.push_back({ n, packed });
+            }
+
+            for (const auto& [inline_sender, packed] : inline_actions) {
+               auto inline_act = unpack<action>(packed);
+               for (const auto& p : inline_act.authorization) check(p.actor == inline_sender, "inline action not authorized by its sender");
+               apply(inline_act.account, inline_act, inline_sender);
+            }
+         }
+
+         void dispatch(const name& code, const name& act) {
+            if (code != self) {
+               if (act == "transfer"_n) execute_action(self, code, &wraplock::deposit);
+               return;
+            }
+            if (act == "init"_n) execute_action(self, code, &wraplock::init);
+            else if (act == "addcontract"_n) execute_action(self, code, &wraplock::addcontract);
+            else if (act == "delcontract"_n) execute_action(self, code, &wraplock::delcontract);
+#if WRAPLOCK_HEAVY_PROOFS
+            else if (act == "withdrawa"_n) execute_action(self, code, &wraplock::withdrawa);
+            else if (act == "withdrawm"_n) execute_action(self, code, &wraplock::withdrawm);
+            else if (act == "cancela"_n) execute_action(self, code, &wraplock::cancela);
+#endif
+#if WRAPLOCK_LIGHT_PROOFS
+            else if (act == "withdrawb"_n) execute_action(self, code, &wraplock::withdrawb);
+            else if (act == "cancelb"_n) execute_action(self, code, &wraplock::cancelb);
+            else if (act == "proofadvice"_n) execute_action(self, code, &wraplock::proofadvice);
+#endif
+            else if (act == "emitxfer"_n) execute_action(self, code, &wraplock::emitxfer);
+            else if (act == "disable"_n) execute_action(self, code, &wraplock::disable);
+            else if (act == "enable"_n) execute_action(self, code, &wraplock::enable);
+            else if (act == "compact"_n) execute_action(self, code, &wraplock::compact);
+            else if (act == "archive"_n) execute_action(self, code, &wraplock::archive);
+            else if (act == "archlegacy"_n) execute_action(self, code, &wraplock::archlegacy);
+            else if (act == "setrefund"_n) execute_action(self, code, &wraplock::setrefund);
+            else if (act == "prunelocks"_n) execute_action(self, code, &wraplock::prunelocks);
+            else if (act == "importrows"_n) execute_action(self, code, &wraplock::importrows);
+            else check(false, "unknown action");
+         }
+
+         std::vector<name> transfer(const action& a) {
+            auto [from, to, quantity, memo] = unpack<std::tuple<name, name, asset, std::string>>(a.data);
+            require_auth(from);
+            check(from != to, "cannot transfer to self");
+            check(is_account(to), "to account does not exist");
+            check(quantity.amount > 0, "must transfer positive quantity");
+            check(memo.size() <= 256, "memo has more than 256 bytes");
+            auto& from_balance = _balances[{ a.account, from, quantity.symbol }];
+            check(from_balance >= quantity.amount, "overdrawn balance");
+            from_balance -= quantity.amount;
+            _balances[{ a.account, to, quantity.symbol }] += quantity.amount;
+            return { from, to };
+         }
+
+         void check_proof(const action& a) {
+            datastream<const char*> ds(a.data.data(), a.data.size());
+            proofcheck::result r = nullptr;
+            if (a.name == "checkproofd"_n) {
+               bridgetypes::heavyproof blockproof;
+               ds >> blockproof;
+               r = _bridge.checkproofd(blockproof);
+            }
+            else if (a.name == "checkproofe"_n) {
+               bridgetypes::heavyproof blockproof;
+               bridgetypes::actionproof actionproof;
+               ds >> blockproof >> actionproof;
+               r = _bridge.checkproofe(blockproof, actionproof);
+            }
+            else if (a.name == "checkprooff"_n) {
+               bridgetypes::lightproof blockproof;
+               bridgetypes::actionproof actionproof;
+               ds >> blockproof >> actionproof;
+               r = _bridge.checkprooff(blockproof, actionproof);
+            }
+            else check(false, "unknown bridge action");
+            check(ds.remaining() == 0, "unexpected data after the proofs");
+            check(r == nullptr, r ? r : "");
+         }
+
+         chainfixture::mock_bridge                                  _bridge;
+         std::map<std::tuple<name, name, symbol>, int64_t>          _balances;
+         std::vector<applied>                                       _applied;
+   };
+
+}
@@ -0,0 +1,200 @@
+#include <algorithm>
+
+#include <wraplock_tester.hpp>
+
+#include <testing.hpp>
+
+using namespace eosio;
+using wraplocktest::eos;
+
+namespace {
+
+   const std::vector<name> users = { "alice"_n, "bob"_n, "carol"_n, "dave"_n, "relayer"_n };
+
+   // shard of wraplock's `resdeltas` holding the deposits of `account`
+   uint8_t shard_of(const name& account) { return (account.value * 0x9E3779B97F4A7C15ULL) >> 60; }
+
+   // a paired chain block retiring `amount` to `beneficiary` on the native chain
+   uint32_t retire(chainfixture::chain& paired, const name& owner, const int64_t amount, const name& beneficiary) {
+      testing::retire(paired, owner, amount, beneficiary);
+      return paired.produce_block();
+   }
+
+   std::string withdraw(wraplocktest::tester& t, const chainfixture::chain& paired, const uint32_t block) {
+      return t.act("withdrawa"_n, "relayer"_n, "relayer"_n, paired.heavy_proof(block), paired.action_proof(block, 0));
+   }
+
+}
+
+TEST_CASE(withdrawals_draw_on_deposits_of_other_shards_without_compact) {
+   auto paired = testing::paired_chain();
+   wraplocktest::tester t(paired, users);
+   REQUIRE(shard_of("alice"_n) != shard_of("bob"_n) && shard_of("carol"_n) != shard_of("bob"_n) && shard_of("alice"_n) != shard_of("carol"_n));
+
+   t.issue("alice"_n, asset(6000, eos));
+   t.issue("carol"_n, asset(4000, eos));
+   REQUIRE(t.transfer("alice"_n, t.self, asset(6000, eos), "alice") == "");
+   REQUIRE(t.transfer("carol"_n, t.self, asset(4000, eos), "carol") == "");
+   REQUIRE(t.reserve() == 10000);
+
+   // bob's shard is empty, the withdrawal takes alice's deposit
+   REQUIRE(withdraw(t, paired, retire(paired, "alice"_n, 5000, "bob"_n)) == "");
+   REQUIRE(t.balance("bob"_n) == 5000 && t.reserve() == 5000);
+
+   // then the rest of alice's and part of carol's, in one withdrawal
+   REQUIRE(withdraw(t, paired, retire(paired, "carol"_n, 3000, "bob"_n)) == "");
+   REQUIRE(t.balance("bob"_n) == 8000 && t.reserve() == 2000);
+
+   // more than the whole reserve is still refused, and the refused withdrawal leaves the shards as they were
+   REQUIRE(withdraw(t, paired, retire(paired, "carol"_n, 2001, "dave"_n)) == "overdrawn balance");
+   REQUIRE(t.balance("dave"_n) == 0 && t.reserve() == 2000);
+}
+
+TEST_CASE(withdrawals_use_the_compacted_reserve_after_the_shards) {
+   auto paired = testing::paired_chain();
+   wraplocktest::tester t(paired, users);
+
+   t.issue("alice"_n, asset(10000, eos));
+   REQUIRE(t.transfer("alice"_n, t.self, asset(7000, eos), "alice") == "");
+   REQUIRE(t.act("compact"_n, "carol"_n, t.token, eos.code()) == "");
+   REQUIRE(t.transfer("alice"_n, t.self, asset(3000, eos), "alice") == "");
+
+   REQUIRE(withdraw(t, paired, retire(paired, "alice"_n, 4000, "bob"_n)) == "");
+   REQUIRE(t.balance("bob"_n) == 4000 && t.reserve() == 6000);
+   REQUIRE(withdraw(t, paired, retire(paired, "alice"_n, 6000, "carol"_n)) == "");
+   REQUIRE(t.balance("carol"_n) == 6000 && t.reserve() == 0);
+}
+
+TEST_CASE(results_report_the_full_reserve) {
+   auto paired = testing::paired_chain();
+   wraplocktest::tester t(paired, users);
+
+   t.issue("alice"_n, asset(6000, eos));
+   t.issue("carol"_n, asset(4000, eos));
+   REQUIRE(t.transfer("alice"_n, t.self, asset(6000, eos), "alice") == "");
+   REQUIRE(t.result<wraplock::opresult>().reserve == asset(6000, eos));
+   REQUIRE(t.transfer("carol"_n, t.self, asset(4000, eos), "carol") == "");
+   REQUIRE(t.result<wraplock::opresult>().reserve == asset(10000, eos));
+
+   REQUIRE(withdraw(t, paired, retire(paired, "alice"_n, 1000, "bob"_n)) == "");
+   auto result = t.result<wraplock::opresult>();
+   REQUIRE(result.reserve == asset(9000, eos) && t.reserve() == 9000);
+   REQUIRE(result.transfer.beneficiary == "bob"_n && result.proof_type == "heavy"_n);
+}
+
+TEST_CASE(proofadvice_points_at_the_earliest_unexpired_stored_proof) {
+   auto paired = testing::paired_chain();
+   wraplocktest::tester t(paired, users);
+   auto expiry = [&](const int32_t seconds) { return time_point(t.now()) + eosio::seconds(seconds); };
+
+   t.store_proof(0, 10, proofcheck::hash_of(uint32_t(10)), expiry(-1));
+   t.store_proof(1, 20, proofcheck::hash_of(uint32_t(20)), expiry(600));
+   t.store_proof(2, 30, proofcheck::hash_of(uint32_t(30)), expiry(600));
+
+   REQUIRE(t.act("proofadvice"_n, "relayer"_n, uint32_t(5)) == "");
+   auto advice = t.result<wraplock::proof_advice>();
+   REQUIRE(advice.light_available && advice.block_height == 20 && advice.root == proofcheck::hash_of(uint32_t(20)));
+
+   REQUIRE(t.act("proofadvice"_n, "relayer"_n, uint32_t(25)) == "");
+   REQUIRE(t.result<wraplock::proof_advice>().block_height == 30);
+
+   // past the last stored proof only a heavy proof will do
+   REQUIRE(t.act("proofadvice"_n, "relayer"_n, uint32_t(31)) == "");
+   REQUIRE(!t.result<wraplock::proof_advice>().light_available);
+}
+
+TEST_CASE(archlegacy_moves_legacy_digests_into_the_accumulator) {
+   auto paired = testing::paired_chain();
+   wraplocktest::tester t(paired, users);
+   t.issue("alice"_n, asset(10000, eos));
+   REQUIRE(t.transfer("alice"_n, t.self, asset(10000, eos), "alice") == "");
+
+   // three withdrawals accepted before epochs, among unrelated digests, and a fourth never proven
+   std::vector<uint32_t> blocks;
+   std::vector<checksum256> digests;
+   for (int i = 0; i < 4; i++) {
+      blocks.push_back(retire(paired, "alice"_n, 100, "bob"_n));
+      digests.push_back(proofcheck::receipt_digest(paired.action_proof(blocks.back(), 0).receipt));
+   }
+   std::vector<checksum256> leaves(digests.begin(), digests.begin() + 3);
+   for (uint32_t i = 0; i < 10; i++) leaves.push_back(proofcheck::hash_of(i));
+   std::array<uint8_t, 32> ones;
+   ones.fill(0xff);
+   leaves.push_back(checksum256(ones));   // above every proof, so each one needs a witness
+   for (const auto& l : leaves) t.add_legacy_digest(l);
+   std::sort(leaves.begin(), leaves.end());
+
+   auto withdraw_with = [&](const uint32_t block, const std::optional<accumulator::nonmembership_witness>& legacy_witness) {
+      return t.act("withdrawa"_n, "relayer"_n, "relayer"_n, paired.heavy_proof(block), paired.action_proof(block, 0),
+                   std::optional<accumulator::nonmembership_witness>(), legacy_witness);
+   };
+
+   REQUIRE(withdraw(t, paired, blocks[0]) == "action already proved");
+
+   // in chunks, until the contract scope is empty
+   REQUIRE(t.act("archlegacy"_n, "alice"_n, uint32_t(5)) == "missing authority of wraplock");
+   REQUIRE(t.act("archlegacy"_n, t.self, uint32_t(5)) == "");
+   REQUIRE(t.act("archlegacy"_n, t.self, uint32_t(100)) == "");
+   REQUIRE(t.act("archlegacy"_n, t.self, uint32_t(100)) == "nothing to archive");
+   wraplock::processedtable legacy_rows( t.self, t.self.value );
+   REQUIRE(legacy_rows.begin() == legacy_rows.end());
+   wraplock::legacyarchive archive( t.self, t.self.value );
+   REQUIRE(archive.get().acc.leaf_count == leaves.size() && archive.get().last_leaf == leaves.back());
+
+   // archived withdrawals stay refused, with or without a forged witness from their neighbours
+   REQUIRE(withdraw(t, paired, blocks[1]) == "legacy digests archived, proof requires a legacy non-membership witness");
+   size_t archived = std::find(leaves.begin(), leaves.end(), digests[1]) - leaves.begin();
+   REQUIRE(archived + 1 < leaves.size());
+   accumulator::nonmembership_witness forged{ archived + 1, accumulator::prove(leaves, archived + 1), std::nullopt };
+   if (archived > 0) forged.lo = accumulator::prove(leaves, archived - 1);
+   REQUIRE(withdraw_with(blocks[1], forged) == "action already proved or invalid legacy non-membership witness");
+
+   // the fourth is proven with a legacy witness alone, its epoch is not archived
+   REQUIRE(withdraw(t, paired, blocks[3]) == "legacy digests archived, proof requires a legacy non-membership witness");
+   REQUIRE(withdraw_with(blocks[3], accumulator::witness(leaves, digests[3])) == "");
+   REQUIRE(t.balance("bob"_n) == 100);
+   REQUIRE(withdraw_with(blocks[3], accumulator::witness(leaves, digests[3])) == "action already proved");
+}
+
+TEST_CASE(direct_refunds_pay_the_recorded_depositor_and_settle_its_lock) {
+   auto paired = testing::paired_chain();
+   wraplocktest::tester t(paired, users);
+   REQUIRE(t.act("setrefund"_n, t.self, true) == "");
+   t.issue("alice"_n, asset(5000, eos));
+   t.issue("carol"_n, asset(2000, eos));
+   auto locks = [&]() {
+      wraplock::locks rows( t.self, t.self.value );
+      size_t count = 0;
+      for (auto itr = rows.begin(); itr != rows.end(); itr++) count++;
+      return count;
+   };
+   auto cancel = [&](const uint32_t block) { return t.act("cancela"_n, "relayer"_n, "relayer"_n, paired.heavy_proof(block), paired.action_proof(block, 0)); };
+
+   // the cancelled transfer back to the depositor refunds it
+   REQUIRE(t.transfer("alice"_n, t.self, asset(3000, eos), "dave") == "");
+   REQUIRE(locks() == 1);
+   REQUIRE(cancel(retire(paired, "dave"_n, 3000, "alice"_n)) == "");
+   REQUIRE(t.emitted().empty() && t.balance("alice"_n) == 5000 && t.reserve() == 0 && locks() == 0);
+
+   // one naming no account of this chain refunds the recorded depositor
+   REQUIRE(t.transfer("carol"_n, t.self, asset(2000, eos), "erin") == "");
+   REQUIRE(cancel(retire(paired, "erin"_n, 2000, "nobody"_n)) == "");
+   REQUIRE(t.result<wraplock::opresult>().transfer.beneficiary == "carol"_n);
+   REQUIRE(t.balance("carol"_n) == 2000 && t.reserve() == 0 && locks() == 0);
+
+   // one to another account is emitted back, the deposit stays locked until its owner withdraws it
+   REQUIRE(t.transfer("alice"_n, t.self, asset(1000, eos), "dave") == "");
+   REQUIRE(cancel(retire(paired, "dave"_n, 1000, "bob"_n)) == "");
+   REQUIRE(t.emitted().size() == 1 && t.emitted()[0].beneficiary == "dave"_n && t.balance("bob"_n) == 0 && locks() == 1);
+   REQUIRE(withdraw(t, paired, retire(paired, "dave"_n, 1000, "alice"_n)) == "");
+   REQUIRE(t.balance("alice"_n) == 5000 && t.reserve() == 0 && locks() == 0);
+
+   // identical deposits get distinct locks, pruned together
+   REQUIRE(t.transfer("alice"_n, t.self, asset(500, eos), "dave") == "");
+   REQUIRE(t.transfer("alice"_n, t.self, asset(500, eos), "dave") == "");
+   REQUIRE(locks() == 2);
+   time_point_sec later(t.now().sec_since_epoch() + 1);
+   REQUIRE(t.act("prunelocks"_n, t.self, later, uint32_t(10)) == "");
+   REQUIRE(locks() == 0);
+   REQUIRE(t.act("prunelocks"_n, t.self, later, uint32_t(10)) == "nothing to prune");
+}